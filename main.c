@@ -0,0 +1,5310 @@
+/* GNU extensions, such as pipe2 and memfd sealing */
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <fnmatch.h>
+#include <stdint.h>
+#include <sys/syscall.h>
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <termios.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <poll.h>
+#include <ctype.h>
+#include <math.h>
+#include <sys/timerfd.h>
+#include <sys/signalfd.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <linux/memfd.h>
+#include <linux/ioprio.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include "smallsh.h"
+
+/* Define macros */
+#define ARGS_INITIAL 16
+#define MAX_EXIT_STATUS 4
+#define ARENA_BLOCK_SIZE 65536
+#define DIRENT_BUFFER_SIZE 262144
+#define INDEX_CHECK_INTERVAL 1
+#define SHUTDOWN_TIMEOUT 5
+#define JOB_NAME_LENGTH 64
+#define TIMEOUT_STATUS 124
+#define TIMEOUT_USAGE_STATUS 125
+#define PIDFD_EVENTS 16
+#define SOURCE_DEPTH_LIMIT 64
+#define SUBST_BUFFER_INITIAL 1024
+#define SUBST_OUTPUT_LIMIT 1048576
+#define REPLAY_TYPE_LENGTH 32
+#define COPROC_LIMIT 16
+#define COPROC_BUFFER_INITIAL 4096
+#define FANOUT_LIMIT 16
+#define FANOUT_PIPE_SIZE 1048576
+#define FANOUT_COPY_SIZE 65536
+#define BACKGROUND_NICE 19
+
+/* Shared job table layout */
+#define JOBTABLE_MAGIC 0x31424f4a48534d53ULL
+#define JOBTABLE_VERSION 1
+#define JOB_FREE 0
+#define JOB_RUNNING 1
+#define JOB_EXITED 2
+#define JOB_SIGNALED 3
+
+/* How far fgboost can lower background jobs: found out the first time it is used */
+#define BOOST_UNCHECKED 0
+#define BOOST_FULL 1
+#define BOOST_IO_ONLY 2
+
+/* Reaping backend used unless --reaper= picks another; set at build time with -DDEFAULT_REAPER=\"name\" */
+#ifndef DEFAULT_REAPER
+#define DEFAULT_REAPER "poll"
+#endif
+
+/* Compiled script cache format */
+#define CACHE_MAGIC "SMSHAST1"
+#define CACHE_VERSION 7
+#define CACHE_HASH_SEED 0xcbf29ce484222325ULL
+#define PROCESS_LIMIT 200
+
+/* struct for user input */
+struct command
+{
+    char **args;                        // Growable array to hold command arguments, NULL terminated
+    int argSize;                        // Holds the next empty index of args array
+    int argCap;                         // Holds the allocated size of args array
+    long argBytes;                      // Holds the size of the argument list, bounded by ARG_MAX
+    _Bool argOverflow;                  // Flag for an argument list longer than ARG_MAX
+    _Bool expandError;                  // Flag for an expansion that failed and was reported, such as a division by zero
+    _Bool background;                   // Flag for a background process command
+    int exitStatus;                     // Exit status of the last foreground process
+    _Bool signalTerm;                   // Flag for a process terminated by a signal
+    int shellPid;                       // smallsh PID
+    char *inputFile;                    // String of the input location for redirection
+    char *inputData;                    // Text of a here-document or here-string to feed to stdin, or NULL
+    char *outputFile;                   // String of the output location for redirection
+    char **teeFiles;                    // Files given with ">+", in the arena, which all get a copy of the output
+    int teeCount;                       // Number of teeFiles
+    _Bool backgroundOff;                // Flag to enable or disable background commands via SIGTSTP
+    _Bool fgBoost;                      // Flag to lower background jobs' priority while a foreground command runs, via set or SIGUSR1
+    _Bool exitShell;                    // Flag set by the exit built-in to leave the main loop
+    int backgroundPids[PROCESS_LIMIT];  // Array to hold background process PIDs; 0 marks a free slot
+    char backgroundNames[PROCESS_LIMIT][JOB_NAME_LENGTH];  // Command lines of the background processes, for jobs
+    _Bool backgroundCoproc[PROCESS_LIMIT];  // Flags for the slots holding a coprocess, which maxjobs does not count
+    int maxJobs;                        // Limit on running background processes, 0 for none; more are queued
+    int shutdownTimeout;                // Seconds background processes get to stop when the shell exits
+    int exitTimeout;                    // Shutdown timeout given to the exit built-in
+    _Bool detachJobs;                   // Flag to leave background processes running when the shell exits
+    long long timeoutNs;                // Timeout set by the timeout built-in for the command being run, or 0
+    long long killAfterNs;              // Time after the timeout to send SIGKILL, or 0
+};
+
+/* Arena block for memory that lives until the end of a command line */
+struct arenaBlock
+{
+    struct arenaBlock *next;  // Previously filled block
+    size_t used;              // Bytes used in data
+    size_t size;              // Bytes available in data
+    char data[];              // Block storage
+};
+
+/* Directory listing cached for glob expansion */
+struct dirListing
+{
+    struct dirListing *next;  // Next cached listing
+    char *path;               // Directory the listing was read from
+    char **names;             // Entry names, excluding "." and ".."
+    int count;                // Number of entry names
+};
+
+/* Directory entry as returned by getdents64 */
+struct linuxDirent64
+{
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+/* Node of the prefix trie of PATH executables; nodes link to each other by index */
+struct trieNode
+{
+    char ch;          // Character on the edge into this node
+    _Bool terminal;   // Flag for a node that ends a command name
+    int child;        // First child, in character order, or -1
+    int sibling;      // Next sibling, in character order, or -1
+};
+
+/* Executables found in one PATH directory */
+struct pathDir
+{
+    char *path;               // Directory path
+    struct timespec mtime;    // Modification time of the directory when it was read
+    char **names;             // Names of the executables
+    int count;                // Number of names
+};
+
+/* Index of the commands on PATH used for tab completion */
+struct cmdIndex
+{
+    struct pathDir *dirs;     // PATH directories, in PATH order
+    int dirCount;             // Number of PATH directories
+    struct trieNode *nodes;   // Trie nodes; node 0 is the root
+    int nodeCount;            // Number of trie nodes
+    int nodeCap;              // Allocated size of nodes
+};
+
+/* Work handed to the index rebuild thread */
+struct indexRequest
+{
+    char *path;               // Copy of PATH to index
+    struct cmdIndex *old;     // Index to compare against, or NULL
+};
+
+/* Candidates for a tab completion */
+struct completion
+{
+    char **names;             // Candidate names
+    int count;                // Number of candidates
+    int cap;                  // Allocated size of names
+};
+
+/* Header of a compiled script cache file; the nodes, words, lines, strings and script path follow it */
+struct cacheHeader
+{
+    char magic[8];         // CACHE_MAGIC
+    uint64_t checksum;     // FNV-1a hash of everything after the header
+    uint64_t scriptSize;   // Size of the script when it was compiled
+    uint64_t inode;        // Inode of the script
+    uint64_t device;       // Device of the script
+    int64_t mtimeSec;      // Modification time of the script
+    int64_t mtimeNsec;
+    uint32_t version;      // CACHE_VERSION
+    uint32_t nodeSize;     // sizeof(struct astNode) in the build that wrote the cache
+    uint32_t wordSize;     // sizeof(struct astWord) in the build that wrote the cache
+    uint32_t nodeCount;    // Number of nodes
+    uint32_t wordCount;    // Number of words
+    uint32_t lineCount;    // Number of lines
+    uint32_t stringLen;    // Size of the string table
+    uint32_t pathLen;      // Length of the script path
+};
+
+/* Background command waiting in the admission queue */
+struct queuedJob
+{
+    int id;            // Job number shown in notices and listings
+    int priority;      // Higher priorities are launched first
+    long seq;          // Order of arrival, for first come first served within a priority
+    char **args;       // Expanded arguments, NULL terminated
+    int argCount;      // Number of arguments
+    char *inputFile;   // Input redirection, or NULL
+    char *inputData;   // Here-document or here-string text, or NULL
+    char *outputFile;  // Output redirection, or NULL
+    char **teeFiles;   // Files given with ">+"
+    int teeCount;      // Number of teeFiles
+    long long timeoutNs;    // Timeout from the timeout built-in, started when the job is launched, or 0
+    long long killAfterNs;  // Time after the timeout to send SIGKILL, or 0
+};
+
+/* Pending timeout of a process */
+struct deadline
+{
+    pid_t pid;              // Process to signal
+    int signal;             // Signal to send
+    long long expiry;       // CLOCK_MONOTONIC time to send it, in nanoseconds
+    long long killAfter;    // Time after that to send SIGKILL, or 0
+};
+
+/* Command substitution "$(...)" in a word of the command being expanded */
+struct substitution
+{
+    char *at;        // Start of the "$(" in the script's string table
+    int span;        // Length of the text from "$(" to the matching ")"
+    pid_t pid;       // Process running the command, or 0 if it ran in the shell
+    int fd;          // Read end of the pipe carrying its output, or -1 once it is read
+    char *output;    // Captured output, in the arena
+    size_t len;      // Bytes captured
+    size_t cap;      // Size of the output buffer
+};
+
+/* Line of a recorded session */
+struct replayLine
+{
+    long long time;  // When it was entered, in nanoseconds since the epoch
+    char *text;      // The line, without its newline
+};
+
+/* Time taken by one command of a replayed session, sent from a replay worker to the shell reporting on them */
+struct replaySample
+{
+    char type[REPLAY_TYPE_LENGTH];  // Command name, or "for" or "while" for a loop
+    long long latency;              // Nanoseconds from when the command was due until it finished
+};
+
+/* Long-lived process started by the coproc built-in, with a pipe to its stdin and one from its stdout */
+struct coprocess
+{
+    char name[JOB_NAME_LENGTH];  // Name given to coproc, or "" for a free slot
+    pid_t pid;                   // Process running the command
+    int toFD;                    // Write end of the pipe to its stdin
+    int fromFD;                  // Read end of the pipe from its stdout
+    char *buffer;                // Output read from the pipe but not yet returned by coproc-read
+    size_t len;                  // Bytes in buffer
+    size_t cap;                  // Allocated size of buffer
+    _Bool ended;                 // Flag set once the pipe from its stdout reaches end of file
+};
+
+/* Output of a command fanned out to several files by ">+": the command writes into a pipe, which the shell copies
+*  into one pipe per extra file with tee(2), then drains into the files with splice(2) */
+struct fanout
+{
+    int sourceFD;                       // Read end of the pipe the command writes to, or -1 for a free slot
+    pid_t pid;                          // Process that was started writing to it
+    int sinkFDs[TEE_LIMIT + 1];         // Files to write to, or -1 for one that failed; the last one takes the source itself
+    int pipeFDs[TEE_LIMIT][2];          // Pipes the source is teed into, one for each file but the last
+    int sinkCount;                      // Number of files
+};
+
+/* Scheduling of a background process before fgboost lowered it */
+struct jobPriority
+{
+    pid_t pid;                 // Process whose priority was lowered
+    pid_t leader;              // Leader of the job's process group
+    int policy;                // Scheduling policy
+    struct sched_param param;  // Scheduling parameters, which hold the real-time priority
+    int nice;                  // Nice value
+    int ioprio;                // I/O priority, as from ioprio_get
+};
+
+/* Saved position in the arena */
+struct arenaMark
+{
+    struct arenaBlock *block;  // Block being filled
+    size_t used;               // Bytes used in that block
+    struct dirListing *cache;  // Directory listings cached at that point
+};
+
+/* Shell variable */
+struct shellVar
+{
+    char *name;
+    char *value;
+};
+
+/* Entry of the shared job table */
+struct jobTableEntry
+{
+    int32_t pid;                    // Process ID, or 0 for a slot not used yet
+    int32_t state;                  // JOB_RUNNING, JOB_EXITED or JOB_SIGNALED
+    int32_t exitStatus;             // Exit value, or the number of the signal that ended the process
+    int32_t reserved;
+    int64_t startTime;              // CLOCK_REALTIME nanoseconds when the process was launched
+    int64_t endTime;                // CLOCK_REALTIME nanoseconds when it was reaped, or 0
+    char command[JOB_NAME_LENGTH];  // Command line, cut to fit
+};
+
+/* Job table shared with monitors through --jobtable. The entries are read under the seqlock: read seq, skip
+*  while it is odd, copy the entries, then read seq again and retry if it changed. The counters are read directly */
+struct jobTable
+{
+    uint64_t magic;                 // JOBTABLE_MAGIC ("SMSHJOB1") once the header is filled in
+    uint32_t version;               // JOBTABLE_VERSION
+    uint32_t entrySize;             // sizeof(struct jobTableEntry)
+    uint32_t capacity;              // Number of background slots
+    int32_t shellPid;               // PID of the shell, or 0 once it has exited
+    uint64_t seq;                   // Seqlock over the entries: odd while the shell is changing them
+    uint64_t launches;              // Commands started, foreground and background
+    uint64_t reaps;                 // Background processes reaped
+    uint64_t failures;              // Commands whose redirection or exec failed
+    uint64_t timeouts;              // Commands stopped by the timeout built-in
+    struct jobTableEntry foreground;           // Last foreground command
+    struct jobTableEntry jobs[PROCESS_LIMIT];  // Background processes by slot; a slot is reused once its process is reaped
+};
+
+/* Reaping backend: how the shell notices that background processes have ended */
+struct reaper
+{
+    char *name;                      // Name given to --reaper=
+    void (*start)(void);             // Set up before the first command runs
+    void (*track)(pid_t childPid);   // Start watching a new background process
+    void (*reap)(void);              // Reap and report the background processes that ended
+    void (*stop)(void);              // Leave reaping to shutdownJobs when the shell exits
+};
+
+/* Function prototypes */
+void checkBackground(void);
+void reapBackground(void);
+struct reaper *findReaper(char *name);
+void reaperNoop(void);
+void reaperNoopTrack(pid_t childPid);
+void sigchldStart(void);
+void sigchldReap(void);
+void sigchldStop(void);
+void signalfdStart(void);
+void signalfdReap(void);
+void pidfdStart(void);
+void pidfdTrack(pid_t childPid);
+void pidfdReap(void);
+int runNode(struct script *script, int node);
+int runFor(struct script *script, int node);
+int runWhile(struct script *script, int node);
+char *expandWord(struct script *script, int word);
+char *expandVars(char *text, size_t textLen);
+char *getVar(char *name, int len);
+void setVar(char *name, char *value);
+void arenaMark(struct arenaMark *mark);
+void arenaRelease(struct arenaMark *mark);
+int openHereInput(char *text);
+int runSubstitutions(struct script *script, int node);
+int startSubstitution(struct substitution *subst, struct substitution *started, int startedCount);
+char *plainCommandName(struct script *script, int root);
+_Bool isPrintingBuiltin(struct script *script, int root);
+_Bool isVarBuiltin(struct script *script, int root);
+void enterSubshell(void);
+int collectSubstitutions(struct substitution *list, int count);
+int readSubstitution(struct substitution *subst);
+struct substitution *findSubstitution(char *at);
+void addFields(char *text, _Bool glob);
+char *evalArithmetic(char *expression, int len);
+char *arithMessage(struct arithExpr *expr);
+char *nextInputLine(struct lineSource *source);
+void freeInputLines(struct lineSource *source);
+int runSimple(struct script *script, int node);
+int exitBuiltin(void);
+int setBuiltin(void);
+int parseNumber(char *text, int *number);
+void reportBackground(int childPid, int childExitStatus);
+void shutdownJobs(int timeout, _Bool detach);
+int waitJobs(pid_t *pids, int *pidFDs, int count, struct timespec *deadline);
+void clearBackground(pid_t childPid);
+void addBackground(pid_t childPid, _Bool coproc);
+int countRunning(void);
+void lowerBackground(void);
+void restoreBackground(void);
+void lowerProcess(pid_t pid, pid_t leader);
+struct jobPriority *findLowered(pid_t pid, pid_t leader);
+int checkBoost(void);
+void queueJob(int priority);
+struct queuedJob *popJob(void);
+_Bool jobBefore(struct queuedJob *a, struct queuedJob *b);
+void admitQueued(void);
+int jobsBuiltin(void);
+int compareJobs(const void *a, const void *b);
+void formatArgs(char *name, char **args);
+int openJobTable(char *name);
+void jobTableBegin(void);
+void jobTableEnd(void);
+void fillJobEntry(struct jobTableEntry *entry, pid_t pid);
+void endJobEntry(struct jobTableEntry *entry, int childExitStatus);
+void recordLaunch(pid_t childPid, int slot);
+void recordReap(pid_t childPid, int childExitStatus);
+void recordForeground(int childExitStatus);
+void recordFailure(void);
+void recordTimeout(void);
+void closeJobTable(void);
+long long monotonicNow(void);
+void addDeadline(pid_t pid, long long expiry, int signal, long long killAfter);
+struct deadline popDeadline(void);
+void siftDeadline(int pos, struct deadline entry);
+void removeDeadlines(pid_t pid);
+void armTimer(void);
+void fireDeadlines(void);
+_Bool isLiveJob(pid_t pid);
+void markTimedOut(pid_t pid);
+int timeoutStatus(pid_t pid, int childExitStatus);
+pid_t waitForeground(pid_t childPid, int *childExitStatus);
+int waitForInput(void);
+_Bool stdinBuffered(void);
+long long parseDuration(char *text);
+int timeoutBuiltin(void);
+int timeoutUsage(void);
+int coprocBuiltin(void);
+int coprocSendBuiltin(void);
+int coprocReadBuiltin(void);
+int coprocCloseBuiltin(void);
+struct coprocess *findCoproc(char *name);
+int startCoproc(struct coprocess *coproc, char **args);
+int readCoprocLine(struct coprocess *coproc, char **line);
+void closeCoproc(struct coprocess *coproc);
+int startFanout(int *writeFD);
+int pumpFanout(struct fanout *fan);
+void spliceOut(struct fanout *fan, int from, int sink, size_t len);
+void finishFanout(int slot);
+int pollFanouts(struct pollfd *pollFDs);
+void pumpFanouts(struct pollfd *pollFDs, int count);
+void closeFanout(struct fanout *fan);
+int runScriptFile(char *path);
+int runScript(struct script *script);
+int sourceBuiltin(void);
+int loadScript(char *path, struct script *script);
+uint64_t hashBytes(const void *data, size_t len, uint64_t hash);
+int scriptCachePath(char *absPath, char *cachePath);
+int mapScriptCache(char *cachePath, struct stat *scriptStat, char *absPath, struct script *script);
+int validateScript(struct script *script);
+void writeScriptCache(char *cachePath, struct stat *scriptStat, char *absPath, struct script *script);
+int executeCommand(void);
+int addArg(char *arg);
+void *arenaAlloc(size_t size);
+void arenaReset(void);
+struct dirListing *loadDirListing(char *path);
+int compareNames(const void *a, const void *b);
+int expandGlob(char *token);
+int readInputLine(char *prompt, char **line, size_t *size);
+void refreshLine(char *prompt, char *buf, int len, int pos);
+int editLine(char *prompt, char **line, size_t *size);
+void completeLine(char *prompt, char **bufPtr, int *cap, int *len, int *pos, _Bool listAll);
+void addCompletion(struct completion *matches, char *name);
+void completeCommand(char *prefix, struct completion *matches);
+void collectTrie(struct trieNode *nodes, int node, char *name, int depth, struct completion *matches);
+void completePath(char *word, struct completion *matches);
+void startIndexRebuild(void);
+void installPendingIndex(void);
+void *rebuildIndex(void *arg);
+void readPathDir(struct pathDir *dir);
+void buildTrie(struct cmdIndex *index);
+void freeIndex(struct cmdIndex *index);
+void recordLine(char *line, int len);
+int loadRecording(char *path);
+char *nextReplayLine(struct lineSource *source);
+int replaySession(char *path, double rate, int concurrency);
+void replayWorker(double rate, long long start, int resultFD);
+void commandType(struct script *script, int node, char *type);
+int compareSamples(const void *a, const void *b);
+void reportReplay(struct replaySample *samples, int count, long long elapsed, int concurrency);
+double percentile(struct replaySample *samples, int count, int percent);
+void handleSIGINT(int signo);
+void handleSIGTSTP(int signo);
+void handleSIGUSR1(int signo);
+void handleSIGCHLD(int signo);
+
+/* Global variables */
+struct command inputs;
+struct script lineScript = {0};
+struct shellVar *shellVars = NULL;
+int varCount = 0, varCap = 0;
+struct queuedJob **jobQueue = NULL;         // Admission queue, a binary heap ordered by jobBefore()
+int queueCount = 0, queueCap = 0;
+int nextJobId = 1;                          // Number of the next queued job
+long jobSeq = 0;                            // Arrival counter for queued jobs
+struct deadline *deadlines = NULL;          // Pending timeouts, a min-heap ordered by expiry
+int deadlineCount = 0, deadlineCap = 0;
+int timerFD = -1;                           // One timerfd, armed for the earliest deadline
+pid_t foregroundPid = 0;                    // Foreground process being waited on, or 0
+pid_t timedOutPids[PROCESS_LIMIT] = {0};    // Processes stopped by their timeout and not yet reaped
+int timedOutNext = 0;                       // Slot of timedOutPids to use next
+int sourceDepth = 0;                        // Number of source built-ins running inside each other
+struct substitution *substs = NULL;         // Command substitutions of the command being expanded, in the arena
+int substCount = 0;                         // Number of substitutions in substs
+struct jobTable *jobTable = NULL;           // Job table shared with monitors, or NULL unless --jobtable is given
+char jobTablePath[PATH_MAX];                // Where monitors find the job table
+_Bool jobTableShm = 0;                      // Flag for a job table made with shm_open, to unlink on exit
+sigset_t jobTableMask;                      // Signal mask to restore when a change to the job table ends
+struct arenaBlock *lineArena = NULL;
+struct dirListing *dirCache = NULL;
+long argMax;
+struct cmdIndex *commandIndex = NULL;       // Command index used by the main thread
+struct cmdIndex *pendingIndex = NULL;       // Index published by the rebuild thread, not yet in use
+int indexRebuilding = 0;                    // Flag for a rebuild thread that is running
+time_t lastIndexCheck = -INDEX_CHECK_INTERVAL;  // When PATH was last checked for changes
+struct sigaction ignoreAction = {{0}}, defaultAction = {{0}}, actionSIGINT = {{0}}, actionSIGTSTP = {{0}}, actionSIGCHLD = {{0}}, actionSIGUSR1 = {{0}};
+volatile sig_atomic_t interrupted = 0;       // Flag set by SIGINT while coproc-read waits
+struct reaper reapers[] = {
+    // Check each background process with waitpid(WNOHANG) before every prompt
+    {"poll", reaperNoop, reaperNoopTrack, checkBackground, reaperNoop},
+    // Reap in a SIGCHLD handler the moment a background process ends
+    {"sigchld", sigchldStart, reaperNoopTrack, sigchldReap, sigchldStop},
+    // Read SIGCHLD from a signalfd polled along with the terminal
+    {"signalfd", signalfdStart, reaperNoopTrack, signalfdReap, reaperNoop},
+    // Poll a pidfd per background process through epoll, waiting only on the ones that ended
+    {"pidfd", pidfdStart, pidfdTrack, pidfdReap, reaperNoop},
+};
+struct reaper *reaper = NULL;               // Selected reaping backend
+int reaperFD = -1;                          // Descriptor the backend needs polled at the prompt, or -1
+int reaperWakeFD = -1;                      // Write end of the sigchld backend's self-pipe, or -1
+FILE *recordFile = NULL;                    // Session record written with --record, or NULL
+struct replayLine *replayLines = NULL;      // Session loaded with --replay
+int replayCount = 0, replayCap = 0;
+int replayNext = 0;                         // Next line a replay worker runs
+struct coprocess coprocs[COPROC_LIMIT];     // Coprocesses by slot; a slot is free again after coproc-close
+struct fanout fanouts[FANOUT_LIMIT];        // Outputs being fanned out by ">+", by slot
+int fanoutCount = 0;                        // Number of fanouts in use
+int boostMode = BOOST_UNCHECKED;            // What fgboost can change and put back
+struct jobPriority *lowered = NULL;         // Background processes lowered for the foreground command
+int loweredCount = 0, loweredCap = 0;
+
+/*
+* Citation for the following signal handler initialization code segment:
+* Date: 02/01/2022
+* Adapted from: Exploration: Signal Handling API
+* Source URLS: https://canvas.oregonstate.edu/courses/1884946/pages/exploration-signal-handling-api?module_item_id=21835981
+* Description: Initialize and set signal handlers;
+*              Main function to display a command line interface and handle commands made by the user
+*/
+int main(int argc, char *argv[]) {
+    /* Initialize command struct */
+    // Allocate the args array; it grows as needed, so only the terminating NULL is set
+    inputs.argCap = ARGS_INITIAL;
+    inputs.args = malloc(inputs.argCap * sizeof(inputs.args[0]));
+    inputs.args[0] = NULL;
+    // Set array of background PIDs to 0 for all elements
+    memset(inputs.backgroundPids, 0, PROCESS_LIMIT * sizeof(inputs.backgroundPids[0]));
+
+    // Initialize args size
+    inputs.argSize = 0;
+
+    // Get the limit on the size of the argument list for exec
+    argMax = sysconf(_SC_ARG_MAX);
+    if (argMax <= 0) {
+        argMax = 131072;
+    }
+    inputs.argBytes = 0;
+
+    // Set flags to 0, as no processes have been run
+    inputs.argOverflow = 0;
+    inputs.expandError = 0;
+    inputs.background = 0;
+    inputs.exitStatus = 0;
+    inputs.signalTerm = 0;
+    inputs.exitShell = 0;
+    inputs.detachJobs = 0;
+    inputs.timeoutNs = 0;
+    inputs.killAfterNs = 0;
+
+    // Background processes get SHUTDOWN_TIMEOUT seconds to stop when the shell exits, unless changed with set or exit
+    inputs.shutdownTimeout = SHUTDOWN_TIMEOUT;
+    inputs.exitTimeout = SHUTDOWN_TIMEOUT;
+    inputs.backgroundOff = 0;
+    inputs.fgBoost = 0;
+
+    // Set input and output file pointers to NULL
+    inputs.inputFile = NULL;
+    inputs.inputData = NULL;
+    inputs.outputFile = NULL;
+    inputs.teeCount = 0;
+    int slot;
+    for (slot = 0; slot < FANOUT_LIMIT; slot++) {
+        fanouts[slot].sourceFD = -1;
+    }
+
+    // Get and store shell PID for variable expansion
+    inputs.shellPid = getpid();
+
+    /* Initialize signal handlers */
+    // Set ignoreAction struct as SIG_IGN for its signal handler
+    ignoreAction.sa_handler = SIG_IGN;
+
+    // Set defaultAction struct as SIG_DFL for its signal handler
+    defaultAction.sa_handler = SIG_DFL;
+
+    /* SIGINT */
+    // Install the ignoreAction as the handler for SIGINT
+    sigaction(SIGINT, &ignoreAction, NULL);
+    // coproc-read catches it instead while it waits, so a coprocess that never answers can be given up on
+    actionSIGINT.sa_handler = handleSIGINT;
+    sigfillset(&actionSIGINT.sa_mask);
+    // No flags set, so the wait is interrupted
+    actionSIGINT.sa_flags = 0;
+
+    /* SIGTSTP */
+    // Register actionSIGTSTP as the signal handler
+    actionSIGTSTP.sa_handler = handleSIGTSTP;
+    // Block all catchable signals while handleSIGTSTP is running
+    sigfillset(&actionSIGTSTP.sa_mask);
+    // No flags set
+    actionSIGTSTP.sa_flags = 0;
+    // Install the actionSIGTSTP signal handler
+    sigaction(SIGTSTP, &actionSIGTSTP, NULL);
+
+    /* SIGUSR1 */
+    // SIGUSR1 turns fgboost on and off, the way SIGTSTP does foreground-only mode
+    actionSIGUSR1.sa_handler = handleSIGUSR1;
+    sigfillset(&actionSIGUSR1.sa_mask);
+    // Restart interrupted reads, so the prompt keeps what was typed
+    actionSIGUSR1.sa_flags = SA_RESTART;
+    sigaction(SIGUSR1, &actionSIGUSR1, NULL);
+
+    /* Options: "--reaper=NAME" picks the reaping backend, "--jobtable[=NAME]" publishes the job table, "--record FILE"
+       logs the session and "--replay FILE [--rate X] [--concurrency N]" replays one as a load test */
+    reaper = findReaper(DEFAULT_REAPER);
+    char *replayPath = NULL;
+    double replayRate = 1;
+    int replayConcurrency = 1;
+    int arg = 1;
+    while (arg < argc && strncmp(argv[arg], "--", 2) == 0) {
+        if (strcmp(argv[arg], "--jobtable") == 0 || strncmp(argv[arg], "--jobtable=", 11) == 0) {
+            // Without a name the table is a memfd; the shell still runs if it can't be made
+            openJobTable(argv[arg][10] == '=' ? argv[arg] + 11 : NULL);
+            arg++;
+            continue;
+        }
+        // The other options take a value, as "--option=VALUE" or "--option VALUE"
+        char *option = argv[arg];
+        char *value = strchr(option, '=');
+        size_t optionLen = value != NULL ? (size_t) (value - option) : strlen(option);
+        if (value != NULL) {
+            value++;
+        }
+        else if (arg + 1 < argc) {
+            value = argv[arg + 1];
+            arg++;
+        }
+        arg++;
+        _Bool valid = value != NULL;
+        char *end = NULL;
+        if (valid && strncmp(option, "--reaper", optionLen) == 0 && optionLen == 8) {
+            valid = findReaper(value) != NULL;
+            if (valid) {
+                reaper = findReaper(value);
+            }
+        }
+        else if (valid && strncmp(option, "--record", optionLen) == 0 && optionLen == 8) {
+            // Lines are appended, so several sessions can go in one record
+            recordFile = fopen(value, "a");
+            if (recordFile == NULL) {
+                perror(value);
+                return 1;
+            }
+        }
+        else if (valid && strncmp(option, "--replay", optionLen) == 0 && optionLen == 8) {
+            replayPath = value;
+        }
+        else if (valid && strncmp(option, "--rate", optionLen) == 0 && optionLen == 6) {
+            // A multiple of the recorded speed, or "max" to run each line as soon as the one before it is done
+            replayRate = strcmp(value, "max") == 0 ? 0 : strtod(value, &end);
+            valid = end == NULL || (*end == '\0' && replayRate > 0);
+        }
+        else if (valid && strncmp(option, "--concurrency", optionLen) == 0 && optionLen == 13) {
+            valid = parseNumber(value, &replayConcurrency) == 0 && replayConcurrency > 0;
+        }
+        else {
+            valid = 0;
+        }
+        if (!valid) {
+            fprintf(stderr, "smallsh: usage: smallsh [--reaper=poll|sigchld|signalfd|pidfd] [--jobtable[=NAME]] [--record FILE] [SCRIPT]\n");
+            fprintf(stderr, "       smallsh --replay FILE [--rate X|max] [--concurrency N]\n");
+            return 2;
+        }
+    }
+
+    /* Replay mode: run a recorded session in concurrent copies of the shell and report how long the commands took */
+    if (replayPath != NULL) {
+        return replaySession(replayPath, replayRate, replayConcurrency);
+    }
+    reaper->start();
+
+    /* Script mode: run the script file given as the first argument instead of reading commands */
+    if (arg < argc) {
+        runScriptFile(argv[arg]);
+        // Reaching the end of the script ends the shell like the exit built-in
+        if (!inputs.exitShell) {
+            inputs.exitTimeout = inputs.shutdownTimeout;
+            inputs.exitShell = 1;
+        }
+    }
+
+    /* Main event loop */
+    while (!inputs.exitShell) {
+        // Report background processes that finished and launch queued jobs in their place
+        reapBackground();
+
+        // Present access of the command line to the user
+        // For use with getline()
+        char *userInput = NULL;
+        size_t bufferSize = 0;
+        // Take in a file name with spaces as necessary; a terminal gets line editing and tab completion
+        int numChars = readInputLine(": ", &userInput, &bufferSize);
+        // If there is an error, handle the error
+        if (numChars == -1) {
+            clearerr(stdin);
+            free(userInput);
+            continue;
+        }
+        // Else, set the last character in the string as taken in by getline() from '\n' to '\0', for comparison in other functions
+        userInput[numChars - 1] = '\0';
+        // Remove any extra whitespace at the end of the input
+        int i = numChars - 2;
+        while (i >= 0 && userInput[i] == ' ') {
+            userInput[i] = '\0';
+            i--;
+        }
+        
+        /* Initial user input parsing */
+        // Handle blank lines (without any commands) or comments:
+        if (userInput[0] == '\0') {
+            // Pass this input and go to free userInput
+        }
+        else if (userInput[0] == '#') {
+            // Print newline for formatting and go to free userInput
+            printf("\n");
+            fflush(stdout);
+        }
+        /* Parse the user inputted command list, then run it */
+        else {
+            // A loop left open at the end of the line is continued on the lines that follow
+            struct lineSource source = {0};
+            source.next = nextInputLine;
+            resetScript(&lineScript);
+            int root = parseCommand(&lineScript, userInput, &source);
+            freeInputLines(&source);
+            if (root == -2) {
+                // Syntax error: nothing was run
+                inputs.signalTerm = 0;
+                inputs.exitStatus = 1;
+            }
+            else if (root >= 0) {
+                runNode(&lineScript, root);
+            }
+        }
+
+        // Reset background flag and input & output strings
+        inputs.background = 0;
+        inputs.inputFile = NULL;
+        inputs.inputData = NULL;
+        inputs.outputFile = NULL;
+        inputs.teeCount = 0;
+        // Free expanded variables, glob matches and cached directory listings of this command line
+        arenaReset();
+        // Free the memory from userInput after each loop
+        free(userInput);
+        // Leave the main loop if the exit built-in was run
+        if (inputs.exitShell) {
+            break;
+        }
+    }
+
+    /* Stop background processes if any, within the shutdown timeout, before returning */
+    // Close the pipes of the coprocesses, which are then stopped along with the other background jobs
+    int i;
+    for (i = 0; i < COPROC_LIMIT; i++) {
+        closeCoproc(&coprocs[i]);
+    }
+    shutdownJobs(inputs.exitTimeout, inputs.detachJobs);
+    // Write out what the stopped jobs left in their ">+" pipes
+    for (i = 0; i < FANOUT_LIMIT; i++) {
+        if (fanouts[i].sourceFD != -1) {
+            finishFanout(i);
+            closeFanout(&fanouts[i]);
+        }
+    }
+    closeJobTable();
+    if (recordFile != NULL) {
+        fclose(recordFile);
+    }
+
+    // return 0 by main() calls exit(), which calls _exit(), which closes all files and performs clean-up
+    return 0;
+}
+
+/*
+* Check if any non-completed background processes are finished, and report the ones that are
+*/
+void checkBackground(void) {
+    int i, childPid, childExitStatus;
+    for (i = 0; i < PROCESS_LIMIT; i++) {
+        // If there is a non-completed background process
+        if (inputs.backgroundPids[i] != 0) {
+            childPid = waitpid(inputs.backgroundPids[i], &childExitStatus, WNOHANG);
+            if (childPid > 0) {
+                // Background process has been completed, print how it ended
+                reportBackground(childPid, childExitStatus);
+                // Clear the background PID from the array since the process was completed
+                inputs.backgroundPids[i] = 0;
+            }
+        }
+    }
+}
+
+/*
+* Reap finished background processes with the selected backend, then launch queued jobs into the slots that freed up
+*/
+void reapBackground(void) {
+    reaper->reap();
+    admitQueued();
+}
+
+/*
+* Look up a reaping backend by name; returns NULL if there is none
+*/
+struct reaper *findReaper(char *name) {
+    int i;
+    for (i = 0; i < (int) (sizeof(reapers) / sizeof(reapers[0])); i++) {
+        if (strcmp(reapers[i].name, name) == 0) {
+            return &reapers[i];
+        }
+    }
+    return NULL;
+}
+
+/*
+* Backend step with nothing to do
+*/
+void reaperNoop(void) {
+}
+
+/*
+* Backend step for a new background process with nothing to do
+*/
+void reaperNoopTrack(pid_t childPid) {
+}
+
+/*
+* sigchld backend: reap in a SIGCHLD handler as soon as a background process ends
+*/
+void sigchldStart(void) {
+    // Register actionSIGCHLD as the signal handler
+    actionSIGCHLD.sa_handler = handleSIGCHLD;
+    // Block all catchable signals while handleSIGCHLD is running
+    sigfillset(&actionSIGCHLD.sa_mask);
+    // No flags set, so a blocking read is interrupted and the prompt can launch queued jobs
+    actionSIGCHLD.sa_flags = 0;
+    // Install the actionSIGCHLD signal handler
+    sigaction(SIGCHLD, &actionSIGCHLD, NULL);
+    // The handler writes to a self-pipe after reaping, so a poll() on reaperFD wakes up to launch queued jobs
+    int wakePipe[2];
+    if (pipe2(wakePipe, O_NONBLOCK | O_CLOEXEC) == 0) {
+        reaperFD = wakePipe[0];
+        reaperWakeFD = wakePipe[1];
+    }
+}
+
+/*
+* sigchld backend: the handler already reaped, so only empty the self-pipe
+*/
+void sigchldReap(void) {
+    char drain[64];
+    while (reaperFD != -1 && read(reaperFD, drain, sizeof(drain)) > 0) {
+        continue;
+    }
+}
+
+/*
+* sigchld backend: stop reaping in the handler
+*/
+void sigchldStop(void) {
+    sigaction(SIGCHLD, &defaultAction, NULL);
+    if (reaperWakeFD != -1) {
+        close(reaperWakeFD);
+        reaperWakeFD = -1;
+    }
+}
+
+/*
+* signalfd backend: keep SIGCHLD blocked and read it from a signalfd polled along with the terminal
+*/
+void signalfdStart(void) {
+    sigset_t childMask;
+    sigemptyset(&childMask);
+    sigaddset(&childMask, SIGCHLD);
+    reaperFD = signalfd(-1, &childMask, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (reaperFD == -1) {
+        // Fall back to polling
+        perror("signalfd() error!");
+        reaper = findReaper("poll");
+        return;
+    }
+    sigprocmask(SIG_BLOCK, &childMask, NULL);
+}
+
+/*
+* signalfd backend: drain the pending SIGCHLDs, then check the background processes, as several exits can share one
+*/
+void signalfdReap(void) {
+    struct signalfd_siginfo info;
+    while (read(reaperFD, &info, sizeof(info)) == sizeof(info)) {
+        continue;
+    }
+    checkBackground();
+}
+
+/*
+* pidfd backend: watch a pidfd for each background process with epoll, so only the processes that ended are waited on
+*/
+void pidfdStart(void) {
+    // Check that the kernel has pidfds, falling back to polling if not
+    int pidFD = -1;
+#ifdef SYS_pidfd_open
+    pidFD = syscall(SYS_pidfd_open, getpid(), 0);
+#endif
+    if (pidFD == -1) {
+        perror("pidfd_open() error!");
+        reaper = findReaper("poll");
+        return;
+    }
+    close(pidFD);
+    reaperFD = epoll_create1(EPOLL_CLOEXEC);
+}
+
+/*
+* pidfd backend: open a pidfd for a new background process and add it to the epoll set
+*/
+void pidfdTrack(pid_t childPid) {
+    int pidFD = -1;
+#ifdef SYS_pidfd_open
+    pidFD = syscall(SYS_pidfd_open, childPid, 0);
+#endif
+    if (pidFD == -1) {
+        // Out of descriptors: the process is then only reaped when the shell exits
+        perror("pidfd_open() error!");
+        return;
+    }
+    // The pid and its pidfd travel in the event data
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.u64 = (uint64_t) pidFD << 32 | (uint32_t) childPid;
+    epoll_ctl(reaperFD, EPOLL_CTL_ADD, pidFD, &event);
+}
+
+/*
+* pidfd backend: wait on the processes whose pidfds became readable
+*/
+void pidfdReap(void) {
+    struct epoll_event events[PIDFD_EVENTS];
+    int i, count, childExitStatus;
+    do {
+        count = epoll_wait(reaperFD, events, PIDFD_EVENTS, 0);
+        for (i = 0; i < count; i++) {
+            pid_t childPid = (pid_t) (uint32_t) events[i].data.u64;
+            pid_t result = waitpid(childPid, &childExitStatus, WNOHANG);
+            if (result > 0) {
+                reportBackground(childPid, childExitStatus);
+                clearBackground(childPid);
+            }
+            // Once the child is reaped, here or elsewhere, close its pidfd, which also takes it out of the epoll set
+            if (result > 0 || (result == -1 && errno == ECHILD)) {
+                close((int) (events[i].data.u64 >> 32));
+            }
+        }
+    } while (count == PIDFD_EVENTS);
+}
+
+/*
+* Run a node of a parsed command list; returns 0 on success, else the failing status
+*/
+int runNode(struct script *script, int node) {
+    int status;
+    switch (script->nodes[node].type) {
+        /* command ; command */
+        case NODE_SEQ: {
+            status = runNode(script, script->nodes[node].left);
+            if (inputs.exitShell) {
+                return status;
+            }
+            return runNode(script, script->nodes[node].right);
+        }
+        /* command && command: run the right side only on success */
+        case NODE_AND: {
+            status = runNode(script, script->nodes[node].left);
+            if (status != 0 || inputs.exitShell) {
+                return status;
+            }
+            return runNode(script, script->nodes[node].right);
+        }
+        /* command || command: run the right side only on failure */
+        case NODE_OR: {
+            status = runNode(script, script->nodes[node].left);
+            if (status == 0 || inputs.exitShell) {
+                return status;
+            }
+            return runNode(script, script->nodes[node].right);
+        }
+        case NODE_FOR: {
+            return runFor(script, node);
+        }
+        case NODE_WHILE: {
+            return runWhile(script, node);
+        }
+        default: {
+            return runSimple(script, node);
+        }
+    }
+}
+
+/*
+* Run the body of a for loop once for each of its expanded words, with the loop variable set to the word
+*/
+int runFor(struct script *script, int node) {
+    struct astNode *loop = &script->nodes[node];
+
+    // Expand the words once, before the first iteration, after running the commands substituted into them
+    if (runSubstitutions(script, node) == -1) {
+        inputs.signalTerm = 0;
+        inputs.exitStatus = 1;
+        return 1;
+    }
+    inputs.argSize = 0;
+    inputs.args[0] = NULL;
+    inputs.argBytes = 0;
+    inputs.argOverflow = 0;
+    inputs.expandError = 0;
+    int i;
+    for (i = loop->wordStart; i < loop->wordStart + loop->wordCount; i++) {
+        char *text = expandWord(script, i);
+        if (script->words[i].flags & WORD_CMDSUB) {
+            // Substituted output is split into words, like the words typed on a command line
+            addFields(text, script->words[i].flags & WORD_GLOB);
+        }
+        else if (script->words[i].flags & WORD_GLOB) {
+            expandGlob(text);
+        }
+        else {
+            addArg(text);
+        }
+    }
+    if (inputs.expandError) {
+        inputs.signalTerm = 0;
+        inputs.exitStatus = 1;
+        return 1;
+    }
+    if (inputs.argOverflow) {
+        printf("smallsh: argument list too long\n");
+        fflush(stdout);
+        inputs.signalTerm = 0;
+        inputs.exitStatus = 1;
+        return 1;
+    }
+    // The body reuses args, so keep the values apart; they stay in the arena until the loop ends
+    int valueCount = inputs.argSize;
+    char **values = arenaAlloc((valueCount + 1) * sizeof(char *));
+    memcpy(values, inputs.args, valueCount * sizeof(char *));
+    char *name = script->strings + script->words[loop->var].str;
+
+    // Memory used by an iteration is given back before the next one
+    struct arenaMark mark;
+    arenaMark(&mark);
+    int status = 0;
+    for (i = 0; i < valueCount && !inputs.exitShell; i++) {
+        setVar(name, values[i]);
+        status = runNode(script, loop->left);
+        arenaRelease(&mark);
+        // Stop the loop if SIGINT killed a command in it
+        if (status == 128 + SIGINT) {
+            break;
+        }
+    }
+    return status;
+}
+
+/*
+* Run the body of a while loop for as long as its condition succeeds
+*/
+int runWhile(struct script *script, int node) {
+    struct arenaMark mark;
+    arenaMark(&mark);
+    int status = 0;
+    while (!inputs.exitShell) {
+        int condition = runNode(script, script->nodes[node].left);
+        if (condition != 0 || inputs.exitShell) {
+            // Stop the loop if SIGINT killed the condition's command
+            if (condition == 128 + SIGINT) {
+                status = condition;
+            }
+            break;
+        }
+        status = runNode(script, script->nodes[node].right);
+        // Memory used by an iteration is given back before the next one
+        arenaRelease(&mark);
+        // Stop the loop if SIGINT killed a command in it
+        if (status == 128 + SIGINT) {
+            break;
+        }
+    }
+    arenaRelease(&mark);
+    return status;
+}
+
+/*
+* Expand a word of the script for the command about to run
+*/
+char *expandWord(struct script *script, int word) {
+    char *text = script->strings + script->words[word].str;
+    if (script->words[word].flags & (WORD_VAR | WORD_CMDSUB | WORD_ARITH)) {
+        // Variables, command output and arithmetic, and any "$$" among them, are substituted in one pass
+        return expandVars(text, strlen(text));
+    }
+    if (script->words[word].flags & WORD_PID) {
+        // Copy the new variable after expansion into the arena so it is freed with the command line
+        char *expanded = varExp(text, inputs.shellPid);
+        text = arenaAlloc(strlen(expanded) + 1);
+        strcpy(text, expanded);
+        free(expanded);
+    }
+    return text;
+}
+
+/*
+* Substitute "$$", "$NAME", "${NAME}", the output of "$(...)" and the value of "$((...))" in the first textLen bytes of
+* text; the result is allocated in the arena
+*/
+char *expandVars(char *text, size_t textLen) {
+    // First pass: measure the result; second pass: build it
+    char shellPidStr[MAX_PID_LENGTH + 1];
+    sprintf(shellPidStr, "%d", inputs.shellPid);
+    char *result = NULL;
+    size_t resultLen = 0;
+    char *end = text + textLen;
+    // Arithmetic is worked out once, in the first pass, as it can set variables
+    char **arithValues = NULL;
+    int arithCount = 0, arithNext;
+    char *c;
+    for (c = strstr(text, "$(("); c != NULL && c < end; c = strstr(c + 1, "$((")) {
+        arithCount++;
+    }
+    if (arithCount > 0) {
+        arithValues = arenaAlloc(arithCount * sizeof(char *));
+    }
+    int pass;
+    for (pass = 0; pass < 2; pass++) {
+        size_t len = 0;
+        arithNext = 0;
+        c = text;
+        while (c < end) {
+            char *value = NULL;
+            int nameLen = 0;
+            struct substitution *subst;
+            char *close = c[0] == '$' && c[1] == '{' ? memchr(c, '}', end - c) : NULL;
+            if (c[0] == '$' && c[1] == '$') {
+                value = shellPidStr;
+                c += 2;
+            }
+            else if (c[0] == '$' && c[1] == '(' && c[2] == '(' && (close = matchArith(c)) != NULL && close < end) {
+                // The expression runs from after "$((" to before "))"
+                if (pass == 0) {
+                    arithValues[arithNext] = evalArithmetic(c + 3, close - c - 4);
+                }
+                value = arithValues[arithNext];
+                arithNext++;
+                c = close + 1;
+            }
+            else if (c[0] == '$' && c[1] == '(' && (subst = findSubstitution(c)) != NULL) {
+                // The output was captured by runSubstitutions()
+                value = subst->output;
+                c += subst->span;
+            }
+            else if (close != NULL && isName(c + 2, close - c - 2)) {
+                nameLen = close - c - 2;
+                value = getVar(c + 2, nameLen);
+                c += nameLen + 3;
+            }
+            else if (c[0] == '$' && (isalpha((unsigned char) c[1]) || c[1] == '_')) {
+                while (c + 1 + nameLen < end && (isalnum((unsigned char) c[1 + nameLen]) || c[1 + nameLen] == '_')) nameLen++;
+                value = getVar(c + 1, nameLen);
+                c += nameLen + 1;
+            }
+            else {
+                // Anything else, including a lone "$", is copied as it is
+                if (pass == 1) result[len] = *c;
+                len++;
+                c++;
+                continue;
+            }
+            size_t valueLen = strlen(value);
+            if (pass == 1) memcpy(result + len, value, valueLen);
+            len += valueLen;
+        }
+        if (pass == 0) {
+            resultLen = len;
+            result = arenaAlloc(resultLen + 1);
+        }
+    }
+    result[resultLen] = '\0';
+    return result;
+}
+
+/*
+* Look up a shell variable, falling back to the environment; an unset variable is empty
+*/
+char *getVar(char *name, int len) {
+    int i;
+    for (i = 0; i < varCount; i++) {
+        if ((int) strlen(shellVars[i].name) == len && strncmp(shellVars[i].name, name, len) == 0) {
+            return shellVars[i].value;
+        }
+    }
+    char *envName = strndup(name, len);
+    char *value = getenv(envName);
+    free(envName);
+    return value != NULL ? value : "";
+}
+
+/*
+* Set a shell variable
+*/
+void setVar(char *name, char *value) {
+    int i;
+    for (i = 0; i < varCount; i++) {
+        if (strcmp(shellVars[i].name, name) == 0) {
+            free(shellVars[i].value);
+            shellVars[i].value = strdup(value);
+            return;
+        }
+    }
+    if (varCount == varCap) {
+        varCap = varCap ? varCap * 2 : 16;
+        shellVars = realloc(shellVars, varCap * sizeof(struct shellVar));
+    }
+    shellVars[varCount].name = strdup(name);
+    shellVars[varCount].value = strdup(value);
+    varCount++;
+}
+
+/*
+* Run the command substitutions in the words of a simple command or for loop, keeping their output for expandVars().
+* Commands are all started before any output is read, so they run at the same time, while built-ins that only print
+* run in the shell; returns -1 if one could not be run or printed too much
+*/
+int runSubstitutions(struct script *script, int node) {
+    struct astNode *cmd = &script->nodes[node];
+    // The words to expand: the command's words and any redirections
+    int words[cmd->wordCount + 2 + cmd->teeCount];
+    int wordCount = 0, i;
+    for (i = cmd->wordStart; i < cmd->wordStart + cmd->wordCount; i++) {
+        words[wordCount++] = i;
+    }
+    if (cmd->inputFile != -1) {
+        words[wordCount++] = cmd->inputFile;
+    }
+    if (cmd->outputFile != -1) {
+        words[wordCount++] = cmd->outputFile;
+    }
+    for (i = cmd->teeStart; i < cmd->teeStart + cmd->teeCount; i++) {
+        words[wordCount++] = i;
+    }
+
+    // Count the substitutions so they fit in one array
+    int count = 0;
+    char *open, *close;
+    for (i = 0; i < wordCount; i++) {
+        if (script->words[words[i]].flags & WORD_CMDSUB) {
+            for (open = nextSubstitution(script->strings + script->words[words[i]].str, &close); open != NULL; open = nextSubstitution(close + 1, &close)) {
+                count++;
+            }
+        }
+    }
+    if (count == 0) {
+        substCount = 0;
+        return 0;
+    }
+
+    // Start every substitution, then read all of their output together
+    struct substitution *list = arenaAlloc(count * sizeof(struct substitution));
+    int started = 0, result = 0;
+    for (i = 0; i < wordCount && result == 0; i++) {
+        if (!(script->words[words[i]].flags & WORD_CMDSUB)) {
+            continue;
+        }
+        for (open = nextSubstitution(script->strings + script->words[words[i]].str, &close); open != NULL; open = nextSubstitution(close + 1, &close)) {
+            struct substitution *subst = &list[started];
+            subst->at = open;
+            subst->span = close - open + 1;
+            if (startSubstitution(subst, list, started) == -1) {
+                result = -1;
+                break;
+            }
+            started++;
+        }
+    }
+    // Substitutions that were started are read and waited on even if a later one failed
+    if (collectSubstitutions(list, started) == -1) {
+        result = -1;
+    }
+    substs = list;
+    substCount = started;
+    return result;
+}
+
+/*
+* Start one command substitution: a built-in that only prints runs in the shell with stdout captured in memory, anything
+* else runs in a forked copy of the shell writing to a pipe. started holds the substitutions already running, whose
+* pipes the copy closes; returns -1 if the command can't be parsed or run
+*/
+int startSubstitution(struct substitution *subst, struct substitution *started, int startedCount) {
+    subst->pid = 0;
+    subst->fd = -1;
+    subst->len = 0;
+    subst->cap = SUBST_BUFFER_INITIAL;
+    subst->output = arenaAlloc(subst->cap + 1);
+    subst->output[0] = '\0';
+
+    // Parse the text between the parentheses from a copy, as the lexer needs the string to itself
+    int textLen = subst->span - 3;
+    char *text = arenaAlloc(textLen + 1);
+    memcpy(text, subst->at + 2, textLen);
+    text[textLen] = '\0';
+    struct script script = {0};
+    int root = parseCommand(&script, text, NULL);
+    if (root == -2) {
+        freeScript(&script);
+        return -1;
+    }
+    if (root == -1) {
+        // Nothing to run: the output is empty
+        freeScript(&script);
+        return 0;
+    }
+
+    // A built-in that only prints changes nothing in the shell, so it runs here with stdout going into memory; one
+    // that sets a variable runs here so the variable is set in this shell
+    if (isPrintingBuiltin(&script, root) || isVarBuiltin(&script, root)) {
+        char *buffer = NULL;
+        size_t size = 0;
+        FILE *savedStdout = stdout;
+        fflush(stdout);
+        stdout = open_memstream(&buffer, &size);
+        if (stdout == NULL) {
+            stdout = savedStdout;
+            perror("open_memstream() error!");
+            freeScript(&script);
+            return -1;
+        }
+        runSimple(&script, root);
+        fclose(stdout);
+        stdout = savedStdout;
+        freeScript(&script);
+        if (size > SUBST_OUTPUT_LIMIT) {
+            free(buffer);
+            printf("smallsh: command substitution output is over %d bytes\n", SUBST_OUTPUT_LIMIT);
+            fflush(stdout);
+            return -1;
+        }
+        subst->output = arenaAlloc(size + 1);
+        memcpy(subst->output, buffer, size);
+        subst->len = size;
+        free(buffer);
+        return 0;
+    }
+
+    // Anything else runs in a copy of the shell, so cd, variables and exit inside it don't change this one
+    int pipeFDs[2];
+    if (pipe2(pipeFDs, O_CLOEXEC) == -1) {
+        perror("pipe2() error!");
+        freeScript(&script);
+        return -1;
+    }
+    // Flush first so the copy doesn't print what this shell has buffered
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == -1) {
+        perror("fork() error!");
+        close(pipeFDs[0]);
+        close(pipeFDs[1]);
+        freeScript(&script);
+        return -1;
+    }
+    if (pid == 0) {
+        // The command's output goes into the pipe; the pipes of the other substitutions are not this process's to read
+        dup2(pipeFDs[1], STDOUT_FILENO);
+        close(pipeFDs[0]);
+        close(pipeFDs[1]);
+        int i;
+        for (i = 0; i < startedCount; i++) {
+            if (started[i].fd != -1) {
+                close(started[i].fd);
+            }
+        }
+        enterSubshell();
+        int status = runNode(&script, root);
+        fflush(stdout);
+        _exit(status);
+    }
+    close(pipeFDs[1]);
+    freeScript(&script);
+    subst->pid = pid;
+    subst->fd = pipeFDs[0];
+    return 0;
+}
+
+/*
+* Name of a parsed command if it could be a built-in run in the shell for a substitution: a simple foreground command
+* with no redirections, whose name is written out rather than coming from an expansion; otherwise NULL
+*/
+char *plainCommandName(struct script *script, int root) {
+    struct astNode *cmd = &script->nodes[root];
+    if (cmd->type != NODE_SIMPLE || cmd->background || cmd->inputFile != -1 || cmd->outputFile != -1 || cmd->teeCount > 0 || cmd->wordCount == 0) {
+        return NULL;
+    }
+    struct astWord *word = &script->words[cmd->wordStart];
+    if (word->flags != 0) {
+        return NULL;
+    }
+    return script->strings + word->str;
+}
+
+/*
+* Check if a parsed command is a built-in that only prints, "status", "jobs", "set" with no arguments or
+* "coproc-read NAME", so it can run in the shell without a fork
+*/
+_Bool isPrintingBuiltin(struct script *script, int root) {
+    char *name = plainCommandName(script, root);
+    int wordCount = script->nodes[root].wordCount;
+    return name != NULL && (strcmp(name, "status") == 0 || strcmp(name, "jobs") == 0 || (strcmp(name, "set") == 0 && wordCount == 1) ||
+                            (strcmp(name, "coproc-read") == 0 && wordCount == 2));
+}
+
+/*
+* Check if a parsed command is "coproc-read NAME VAR", which must run in the shell: it takes a line the shell may
+* already hold for the coprocess and sets VAR in the shell, where a forked copy would lose both
+*/
+_Bool isVarBuiltin(struct script *script, int root) {
+    char *name = plainCommandName(script, root);
+    return name != NULL && strcmp(name, "coproc-read") == 0 && script->nodes[root].wordCount == 3;
+}
+
+/*
+* Set up a forked copy of the shell that runs a command substitution: the parent's background processes, queued jobs,
+* timeouts, reaping descriptors and job table are left to the parent, and commands are only waited on in the foreground
+*/
+void enterSubshell(void) {
+    memset(inputs.backgroundPids, 0, PROCESS_LIMIT * sizeof(inputs.backgroundPids[0]));
+    queueCount = 0;
+    deadlineCount = 0;
+    if (timerFD != -1) {
+        close(timerFD);
+        timerFD = -1;
+    }
+    reaper->stop();
+    if (reaperFD != -1) {
+        close(reaperFD);
+        reaperFD = -1;
+    }
+    reaper = findReaper("poll");
+    // The mapping stays, but only the parent shell writes to it
+    jobTable = NULL;
+    // The parent copies the ">+" outputs
+    int i;
+    for (i = 0; i < FANOUT_LIMIT; i++) {
+        if (fanouts[i].sourceFD != -1) {
+            closeFanout(&fanouts[i]);
+        }
+    }
+}
+
+/*
+* Read the output of the forked substitutions as it arrives, then wait on them and trim trailing newlines from all of
+* the output; returns -1 if one printed more than SUBST_OUTPUT_LIMIT bytes
+*/
+int collectSubstitutions(struct substitution *list, int count) {
+    struct pollfd *fds = arenaAlloc(count * sizeof(struct pollfd));
+    int *owners = arenaAlloc(count * sizeof(int));
+    int result = 0, i;
+    while (1) {
+        // Poll the pipes that are still open
+        int open = 0;
+        for (i = 0; i < count; i++) {
+            if (list[i].fd != -1) {
+                fds[open].fd = list[i].fd;
+                fds[open].events = POLLIN;
+                owners[open] = i;
+                open++;
+            }
+        }
+        if (open == 0) {
+            break;
+        }
+        if (poll(fds, open, -1) == -1) {
+            // A SIGCHLD handler may interrupt the poll
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("poll() error!");
+            break;
+        }
+        for (i = 0; i < open; i++) {
+            if (fds[i].revents == 0) {
+                continue;
+            }
+            int status = readSubstitution(&list[owners[i]]);
+            if (status == 0) {
+                continue;
+            }
+            // At end of output, or too much of it; a command still writing gets SIGPIPE
+            if (status == -1) {
+                result = -1;
+            }
+            close(list[owners[i]].fd);
+            list[owners[i]].fd = -1;
+        }
+    }
+    for (i = 0; i < count; i++) {
+        if (list[i].fd != -1) {
+            close(list[i].fd);
+            list[i].fd = -1;
+        }
+        if (list[i].pid > 0) {
+            int childExitStatus;
+            while (waitpid(list[i].pid, &childExitStatus, 0) == -1 && errno == EINTR) {
+                continue;
+            }
+        }
+        // Trailing newlines are dropped, as the output is used as words
+        while (list[i].len > 0 && list[i].output[list[i].len - 1] == '\n') {
+            list[i].len--;
+        }
+        list[i].output[list[i].len] = '\0';
+    }
+    if (result == -1) {
+        printf("smallsh: command substitution output is over %d bytes\n", SUBST_OUTPUT_LIMIT);
+        fflush(stdout);
+    }
+    return result;
+}
+
+/*
+* Read what is available from a substitution's pipe into its buffer, growing the buffer in the arena as needed;
+* returns 0 to keep reading, 1 at the end of the output, or -1 once it is over SUBST_OUTPUT_LIMIT bytes
+*/
+int readSubstitution(struct substitution *subst) {
+    if (subst->len == subst->cap) {
+        // Double the buffer; the old one is given back with the rest of the arena
+        char *grown = arenaAlloc(subst->cap * 2 + 1);
+        memcpy(grown, subst->output, subst->len);
+        subst->output = grown;
+        subst->cap *= 2;
+    }
+    ssize_t count = read(subst->fd, subst->output + subst->len, subst->cap - subst->len);
+    if (count == -1) {
+        return errno == EINTR || errno == EAGAIN ? 0 : 1;
+    }
+    if (count == 0) {
+        return 1;
+    }
+    subst->len += count;
+    return subst->len > SUBST_OUTPUT_LIMIT ? -1 : 0;
+}
+
+/*
+* Look up the captured substitution that starts at the given "$(" of the command being expanded
+*/
+struct substitution *findSubstitution(char *at) {
+    int i;
+    for (i = 0; i < substCount; i++) {
+        if (substs[i].at == at) {
+            return &substs[i];
+        }
+    }
+    return NULL;
+}
+
+/*
+* Add a word with substituted command output to args, split at spaces, tabs and newlines; each part is matched against
+* files if the word had wildcards
+*/
+void addFields(char *text, _Bool glob) {
+    char *saveptr;
+    char *field;
+    for (field = strtok_r(text, " \t\n", &saveptr); field != NULL; field = strtok_r(NULL, " \t\n", &saveptr)) {
+        if (glob) {
+            expandGlob(field);
+        }
+        else {
+            addArg(field);
+        }
+    }
+}
+
+/*
+* Work out an arithmetic expansion as its command runs, after substituting variables and command output in it; an error
+* is reported and sets expandError. Returns the value as text in the arena
+*/
+char *evalArithmetic(char *expression, int len) {
+    char *text = expandVars(expression, len);
+    struct arithExpr expr;
+    long long value = 0;
+    int root = parseArith(&expr, text);
+    if (root != -1) {
+        // Variables are the shell's, falling back to the environment
+        expr.readVar = getVar;
+        expr.writeVar = setVar;
+        expr.error = evalArith(&expr, root, &value);
+    }
+    if (expr.error != ARITH_OK) {
+        printf("smallsh: $((%s)): %s\n", text, arithMessage(&expr));
+        fflush(stdout);
+        inputs.expandError = 1;
+        value = 0;
+    }
+    free(expr.nodes);
+    char *result = arenaAlloc(MAX_LLONG_LENGTH + 1);
+    sprintf(result, "%lld", value);
+    return result;
+}
+
+/*
+* Describe an arithmetic error
+*/
+char *arithMessage(struct arithExpr *expr) {
+    switch (expr->error) {
+        case ARITH_DIVZERO: {
+            return "division by zero";
+        }
+        case ARITH_OVERFLOW: {
+            return "integer overflow";
+        }
+        case ARITH_NOTNUMBER: {
+            // Kept in the arena with the rest of the message's command line
+            char *message = arenaAlloc(expr->errorLen + 16);
+            sprintf(message, "%.*s: not a number", expr->errorLen, expr->errorName);
+            return message;
+        }
+        default: {
+            return "syntax error";
+        }
+    }
+}
+
+/*
+* Expand and run a simple command, either as a built-in or as a new process
+*/
+int runSimple(struct script *script, int node) {
+    struct astNode *cmd = &script->nodes[node];
+
+    // Run the commands substituted into the words before anything is expanded; nothing is run if one fails
+    if (runSubstitutions(script, node) == -1) {
+        inputs.signalTerm = 0;
+        inputs.exitStatus = 1;
+        return 1;
+    }
+
+    // Reset the argument list; args stays allocated for the next command
+    inputs.argSize = 0;
+    inputs.args[0] = NULL;
+    inputs.argBytes = 0;
+    inputs.argOverflow = 0;
+    inputs.expandError = 0;
+    inputs.timeoutNs = 0;
+
+    // Don't process background commands if backgroundOff flag is True
+    inputs.background = cmd->background && !inputs.backgroundOff;
+    inputs.inputFile = NULL;
+    inputs.inputData = NULL;
+    if (cmd->inputFile != -1) {
+        // Here-documents and here-strings give the text to read rather than a file name
+        char *input = expandWord(script, cmd->inputFile);
+        if (script->words[cmd->inputFile].flags & WORD_HEREDOC) {
+            inputs.inputData = input;
+        }
+        else {
+            inputs.inputFile = input;
+        }
+    }
+    inputs.outputFile = cmd->outputFile == -1 ? NULL : expandWord(script, cmd->outputFile);
+    inputs.teeCount = cmd->teeCount;
+    inputs.teeFiles = arenaAlloc(cmd->teeCount * sizeof(char *));
+    int tee;
+    for (tee = 0; tee < cmd->teeCount; tee++) {
+        inputs.teeFiles[tee] = expandWord(script, cmd->teeStart + tee);
+    }
+
+    // Expand the words into args
+    int i;
+    for (i = cmd->wordStart; i < cmd->wordStart + cmd->wordCount; i++) {
+        char *text = expandWord(script, i);
+        if (script->words[i].flags & WORD_CMDSUB) {
+            // Substituted output is split into words, like the words typed on a command line
+            addFields(text, script->words[i].flags & WORD_GLOB);
+        }
+        else if (script->words[i].flags & WORD_GLOB) {
+            expandGlob(text);
+        }
+        else {
+            addArg(text);
+        }
+    }
+
+    // An arithmetic error was reported while expanding; the command is not run
+    if (inputs.expandError) {
+        inputs.signalTerm = 0;
+        inputs.exitStatus = 1;
+        return 1;
+    }
+    // If the argument list was too long, report the error instead of executing
+    if (inputs.argOverflow) {
+        printf("smallsh: argument list too long\n");
+        fflush(stdout);
+        inputs.signalTerm = 0;
+        inputs.exitStatus = 1;
+        return 1;
+    }
+    if (inputs.argSize == 0) {
+        return 0;
+    }
+
+    // timeout sets a deadline for the command that follows it
+    if (strcmp(inputs.args[0], "timeout") == 0 && timeoutBuiltin() == -1) {
+        inputs.signalTerm = 0;
+        inputs.exitStatus = TIMEOUT_USAGE_STATUS;
+        return TIMEOUT_USAGE_STATUS;
+    }
+
+    /* Built-in functions; & is ignored for built-in commands */
+    if (strcmp(inputs.args[0], "exit") == 0) {
+        return exitBuiltin() == 0 ? 0 : 1;
+    }
+    else if (strcmp(inputs.args[0], "cd") == 0) {
+        // With no arguments, change directory to HOME env variable
+        char *path = inputs.argSize > 1 ? inputs.args[1] : getenv("HOME");
+        if (path == NULL || chdir(path) == -1) {
+            perror("cd");
+            return 1;
+        }
+        return 0;
+    }
+    else if (strcmp(inputs.args[0], "status") == 0) {
+        if (!inputs.signalTerm) {
+            // Return the exit status
+            printf("exit value %d\n", inputs.exitStatus);
+            fflush(stdout);
+        }
+        else {
+            // Return the last signal status by a foreground process
+            printf("terminated by signal %d\n", inputs.exitStatus);
+            fflush(stdout);
+        }
+        return 0;
+    }
+    else if (strcmp(inputs.args[0], "set") == 0) {
+        return setBuiltin();
+    }
+    else if (strcmp(inputs.args[0], "jobs") == 0) {
+        return jobsBuiltin();
+    }
+    else if (strcmp(inputs.args[0], "source") == 0 || strcmp(inputs.args[0], ".") == 0) {
+        return sourceBuiltin();
+    }
+    else if (strcmp(inputs.args[0], "coproc") == 0) {
+        return coprocBuiltin();
+    }
+    else if (strcmp(inputs.args[0], "coproc-send") == 0) {
+        return coprocSendBuiltin();
+    }
+    else if (strcmp(inputs.args[0], "coproc-read") == 0) {
+        return coprocReadBuiltin();
+    }
+    else if (strcmp(inputs.args[0], "coproc-close") == 0) {
+        return coprocCloseBuiltin();
+    }
+
+    /* Admission control: with maxjobs set, a background command waits while the limit is reached or others are waiting */
+    if (inputs.background && inputs.maxJobs > 0 && (countRunning() >= inputs.maxJobs || queueCount > 0)) {
+        queueJob(cmd->priority);
+        admitQueued();
+        return 0;
+    }
+
+    /* Execute command */
+    executeCommand();
+    // Launching a background command succeeds; a foreground command reports how it ended
+    if (inputs.background) {
+        return 0;
+    }
+    return inputs.signalTerm ? 128 + inputs.exitStatus : inputs.exitStatus;
+}
+
+/*
+* Built-in exit: "exit [--detach] [--timeout SECONDS]"; returns -1 on a bad option, leaving the shell running
+*/
+int exitBuiltin(void) {
+    inputs.detachJobs = 0;
+    inputs.exitTimeout = inputs.shutdownTimeout;
+    int i;
+    for (i = 1; i < inputs.argSize; i++) {
+        if (strcmp(inputs.args[i], "--detach") == 0) {
+            inputs.detachJobs = 1;
+        }
+        else if (strcmp(inputs.args[i], "--timeout") == 0 && i + 1 < inputs.argSize && parseNumber(inputs.args[i + 1], &inputs.exitTimeout) == 0) {
+            i++;
+        }
+        else if (strncmp(inputs.args[i], "--timeout=", 10) == 0 && parseNumber(inputs.args[i] + 10, &inputs.exitTimeout) == 0) {
+            continue;
+        }
+        else {
+            printf("smallsh: exit: usage: exit [--detach] [--timeout SECONDS]\n");
+            fflush(stdout);
+            return -1;
+        }
+    }
+    // Stop running commands and leave the main loop
+    inputs.exitShell = 1;
+    return 0;
+}
+
+/*
+* Built-in set: "set" lists the settings, "set NAME VALUE" changes one
+*/
+int setBuiltin(void) {
+    if (inputs.argSize == 1) {
+        printf("maxjobs %d\n", inputs.maxJobs);
+        printf("shutdowntimeout %d\n", inputs.shutdownTimeout);
+        printf("fgboost %s\n", inputs.fgBoost ? "on" : "off");
+        if (jobTable != NULL) {
+            printf("jobtable %s\n", jobTablePath);
+        }
+        fflush(stdout);
+        return 0;
+    }
+    if (inputs.argSize == 3 && strcmp(inputs.args[1], "maxjobs") == 0 && parseNumber(inputs.args[2], &inputs.maxJobs) == 0) {
+        // A higher limit may let queued jobs start now
+        admitQueued();
+        return 0;
+    }
+    if (inputs.argSize == 3 && strcmp(inputs.args[1], "shutdowntimeout") == 0 && parseNumber(inputs.args[2], &inputs.shutdownTimeout) == 0) {
+        return 0;
+    }
+    if (inputs.argSize == 3 && strcmp(inputs.args[1], "fgboost") == 0 && (strcmp(inputs.args[2], "on") == 0 || strcmp(inputs.args[2], "off") == 0)) {
+        inputs.fgBoost = strcmp(inputs.args[2], "on") == 0;
+        return 0;
+    }
+    printf("smallsh: set: usage: set [maxjobs N | shutdowntimeout SECONDS | fgboost on|off]\n");
+    fflush(stdout);
+    return 1;
+}
+
+/*
+* Parse a non-negative whole number
+*/
+int parseNumber(char *text, int *number) {
+    char *end;
+    long value = strtol(text, &end, 10);
+    if (text[0] == '\0' || *end != '\0' || value < 0 || value > INT_MAX) {
+        return -1;
+    }
+    *number = value;
+    return 0;
+}
+
+/*
+* Citation for the following function:
+* Date: 01/28/2022
+* Adapted from: Exploration: Process API - Executing a New Program; Exploration: Processes and I/O
+* Source URLS: https://canvas.oregonstate.edu/courses/1884946/pages/exploration-process-api-executing-a-new-program?module_item_id=21835974
+*              https://canvas.oregonstate.edu/courses/1884946/pages/exploration-processes-and-i-slash-o?module_item_id=21835982
+* Description: Execute a new program by forking a child process and calling an exec function to run the new program
+*/
+int executeCommand(void) {
+    // Initialize variable to hold child exit status from forked child process
+    int childExitStatus;
+
+    // Fill a pipe or memfd with here-document text before forking, so the child only has to dup2 it
+    int hereFD = -1;
+    if (inputs.inputData != NULL) {
+        hereFD = openHereInput(inputs.inputData);
+        if (hereFD == -1) {
+            perror("here-document");
+            inputs.signalTerm = 0;
+            inputs.exitStatus = 1;
+            return 0;
+        }
+    }
+
+    // With ">+" files, the shell opens them and the command writes into a pipe that the shell fans out to them
+    int fanWriteFD = -1, fanSlot = -1;
+    if (inputs.teeCount > 0) {
+        fanSlot = startFanout(&fanWriteFD);
+        if (fanSlot == -1) {
+            if (hereFD != -1) {
+                close(hereFD);
+            }
+            recordFailure();
+            inputs.signalTerm = 0;
+            inputs.exitStatus = 1;
+            return 0;
+        }
+    }
+
+    // Hold SIGCHLD from the fork until a background command is stored, so a SIGCHLD handler can't reap it first
+    sigset_t childMask, oldMask;
+    sigemptyset(&childMask);
+    sigaddset(&childMask, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &childMask, &oldMask);
+
+    /* Fork and exec user inputted commands */
+    pid_t childPid = fork();
+    switch (childPid) {
+        /* Fork error */
+        case -1: {
+            perror("fork() error!\n");
+            exit(1);
+            break;
+        }
+        /* Child process */
+        case 0: {
+            // Initialize variables as file descriptors for redirection if needed
+            int sourceFD, targetFD, result;
+
+            // A here-document or here-string is read from the descriptor the parent filled
+            if (hereFD != -1) {
+                result = dup2(hereFD, 0);
+                if (result == -1) {
+                    perror("source dup2() error!");
+                    exit(1);
+                }
+            }
+            // Check for input redirection
+            else if (inputs.inputFile != NULL || (inputs.inputFile == NULL && inputs.background)) {
+                // Open source file
+                if (inputs.background) {
+                    // Background command was made and stdin was not redirected; redirect to /dev/null
+                    sourceFD = open("/dev/null", O_RDONLY);
+                }
+                else {
+                    // Foreground command was made and stdin was redirected
+                    sourceFD = open(inputs.inputFile, O_RDONLY);
+                }
+                if (sourceFD == -1) {
+                    printf("cannot open %s for input\n", inputs.inputFile);
+                    fflush(stdout);
+                    recordFailure();
+                    exit(1);
+                }
+                // Redirect stdin to source file
+                result = dup2(sourceFD, 0);
+                if (result == -1) {
+                    perror("source dup2() error!");
+                    exit(1);
+                }
+            }
+
+            // Output fanned out by the shell goes into its pipe
+            if (fanWriteFD != -1) {
+                result = dup2(fanWriteFD, 1);
+                if (result == -1) {
+                    perror("target dup2() error!");
+                    exit(1);
+                }
+            }
+            // Check for output redirection
+            else if (inputs.outputFile != NULL || (inputs.outputFile == NULL && inputs.background)) {
+                // Open target file
+                if (inputs.background) {
+                    // Background command was made and stdout was not redirected; redirect to /dev/null
+                    targetFD = open("/dev/null", O_WRONLY);
+                }
+                else {
+                    // Foreground command was made and stdout was redirected
+                    targetFD = open(inputs.outputFile, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+                }
+                if (targetFD == -1) {
+                    perror("target open() error!");
+                    recordFailure();
+                    exit(1);
+                }
+                // Redirect stdout to target file
+                result = dup2(targetFD, 1);
+                if (result == -1) {
+                    perror("target dup2() error!");
+                    exit(1);
+                }
+            }
+            // Put a background process in its own process group, so it can be signalled as a job and terminal signals don't reach it
+            if (inputs.background) {
+                setpgid(0, 0);
+            }
+            // If foreground process is being run, set SIGINT back to default
+            sigaction(SIGINT, &defaultAction, NULL);
+            // The program gets SIGCHLD unblocked, whatever the reaping backend
+            sigprocmask(SIG_UNBLOCK, &childMask, NULL);
+            // Run the program using execvp in the child process
+            execvp(inputs.args[0], inputs.args);
+            // exec only returns if there is an error
+            perror(inputs.args[0]);
+            recordFailure();
+            exit(1);
+            break;
+        }
+        /* Parent process */
+        default: {
+            // The child has its own copy of the here-document descriptor
+            if (hereFD != -1) {
+                close(hereFD);
+            }
+            // Only the command writes to the fanout pipe, so it ends when the command and its children are done
+            if (fanWriteFD != -1) {
+                close(fanWriteFD);
+                fanouts[fanSlot].pid = childPid;
+            }
+            /* Background command */
+            // Start the deadline of a command run under timeout
+            if (inputs.timeoutNs > 0) {
+                addDeadline(childPid, monotonicNow() + inputs.timeoutNs, SIGTERM, inputs.killAfterNs);
+            }
+            if (inputs.background) {
+                // Also set the process group from the parent, so it is in place whichever process runs first
+                setpgid(childPid, childPid);
+            }
+            /* Foreground command */
+            else {
+                recordLaunch(childPid, -1);
+                // Let SIGCHLD through while the command runs, so background jobs that end meanwhile are reaped; the
+                // handler only waits on stored background PIDs, leaving this one to waitForeground()
+                sigprocmask(SIG_SETMASK, &oldMask, NULL);
+                // With fgboost, the background jobs give way to the command while it runs
+                if (inputs.fgBoost) {
+                    lowerBackground();
+                }
+                // Wait for the child process and block before continuing, firing any deadlines that come due
+                childPid = waitForeground(childPid, &childExitStatus);
+                if (inputs.fgBoost) {
+                    restoreBackground();
+                }
+                recordForeground(childExitStatus);
+                // Write out what the command left in its fanout pipe
+                if (fanSlot != -1) {
+                    finishFanout(fanSlot);
+                }
+                // Check and set exit status
+                if (WIFEXITED(childExitStatus)) {
+                    // If child terminated normally, set signal terminated flag to False
+                    inputs.signalTerm = 0;
+                    // Store the status value
+                    inputs.exitStatus = WEXITSTATUS(childExitStatus);
+                }
+                else if (WIFSIGNALED(childExitStatus)) {
+                    // If child terminated abnormally, set signal terminated flag to True
+                    inputs.signalTerm = 1;
+                    // Store the status value
+                    inputs.exitStatus = WTERMSIG(childExitStatus);
+                    // Immediately print out the number of the signal that killed the foreground child process
+                    printf("terminated by signal %d\n", inputs.exitStatus);
+                    fflush(stdout);
+                }
+                // Reset SIGINT signal handler back to ignore
+                sigaction(SIGINT, &ignoreAction, NULL);
+            }
+
+            // Print child background pid if background process
+            if (inputs.background) {
+                // Print child background pid
+                printf("background pid is: %d\n", childPid);
+                fflush(stdout);
+                // Store the child background pid in an array and have the reaping backend watch it
+                addBackground(childPid, 0);
+                reaper->track(childPid);
+                // Let SIGCHLD through again
+                sigprocmask(SIG_SETMASK, &oldMask, NULL);
+            }
+        }
+    }
+    return 0;
+}
+
+/*
+* Open a descriptor that reads the given text from its start: a pipe when the text fits in its buffer,
+* otherwise a sealed memfd, so no temporary file is made and no process has to write it
+*/
+int openHereInput(char *text) {
+    size_t len = strlen(text);
+    if (len <= PIPE_BUF) {
+        int pipeFDs[2];
+        if (pipe2(pipeFDs, O_CLOEXEC) == -1) {
+            return -1;
+        }
+        // The whole text fits in the pipe, so the write doesn't block and the reader gets end of file after it
+        if (write(pipeFDs[1], text, len) != (ssize_t) len) {
+            close(pipeFDs[0]);
+            close(pipeFDs[1]);
+            return -1;
+        }
+        close(pipeFDs[1]);
+        return pipeFDs[0];
+    }
+    int fd = syscall(SYS_memfd_create, "smallsh-heredoc", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (fd == -1) {
+        return -1;
+    }
+    size_t done = 0;
+    while (done < len) {
+        ssize_t written = write(fd, text + done, len - done);
+        if (written == -1) {
+            close(fd);
+            return -1;
+        }
+        done += written;
+    }
+    // Seal the contents so the command reads exactly this text, then rewind to the start
+    if (fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL) == -1 || lseek(fd, 0, SEEK_SET) == -1) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/*
+* Open the command's ">" and ">+" files and the pipes to fan its output out to them, in a free fanout slot. Sets
+* writeFD to the pipe the command is to write to and returns the slot, or -1 if something can't be opened
+*/
+int startFanout(int *writeFD) {
+    int slot;
+    for (slot = 0; slot < FANOUT_LIMIT && fanouts[slot].sourceFD != -1; slot++) {
+        continue;
+    }
+    if (slot == FANOUT_LIMIT) {
+        printf("smallsh: more than %d commands with >+ outputs\n", FANOUT_LIMIT);
+        fflush(stdout);
+        return -1;
+    }
+    struct fanout *fan = &fanouts[slot];
+    fan->pid = 0;
+    fan->sinkCount = 0;
+    int i;
+    for (i = 0; i < TEE_LIMIT; i++) {
+        fan->pipeFDs[i][0] = -1;
+    }
+
+    // A ">" file is one more copy, written first
+    for (i = -1; i < inputs.teeCount; i++) {
+        char *path = i == -1 ? inputs.outputFile : inputs.teeFiles[i];
+        if (path == NULL) {
+            continue;
+        }
+        int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd == -1) {
+            perror(path);
+            closeFanout(fan);
+            return -1;
+        }
+        fan->sinkFDs[fan->sinkCount] = fd;
+        fan->sinkCount++;
+    }
+
+    // tee() into an empty pipe copies everything in the source only if it is no smaller, so all of them get the size
+    // of the smallest; bigger pipes mean fewer rounds of copying
+    int pipeSize = FANOUT_PIPE_SIZE;
+    for (i = 0; i < fan->sinkCount - 1; i++) {
+        if (pipe2(fan->pipeFDs[i], O_CLOEXEC) == -1) {
+            perror("pipe2() error!");
+            closeFanout(fan);
+            return -1;
+        }
+        fcntl(fan->pipeFDs[i][1], F_SETPIPE_SZ, pipeSize);
+        int size = fcntl(fan->pipeFDs[i][1], F_GETPIPE_SZ);
+        if (size > 0 && size < pipeSize) {
+            pipeSize = size;
+        }
+    }
+    int sourcePipe[2];
+    if (pipe2(sourcePipe, O_CLOEXEC) == -1) {
+        perror("pipe2() error!");
+        closeFanout(fan);
+        return -1;
+    }
+    fcntl(sourcePipe[1], F_SETPIPE_SZ, pipeSize);
+    if (fan->sinkCount > 1 && fcntl(sourcePipe[1], F_GETPIPE_SZ) > pipeSize) {
+        printf("smallsh: cannot size the pipes for >+\n");
+        fflush(stdout);
+        close(sourcePipe[0]);
+        close(sourcePipe[1]);
+        closeFanout(fan);
+        return -1;
+    }
+    fan->sourceFD = sourcePipe[0];
+    fanoutCount++;
+    *writeFD = sourcePipe[1];
+    return slot;
+}
+
+/*
+* Copy what the command has written so far to every file: tee() the source into each file's pipe but the last, splice
+* those pipes into their files, then splice the source itself into the last file. Called once poll() finds the source
+* readable; returns 0, or -1 once it has reached end of file
+*/
+int pumpFanout(struct fanout *fan) {
+    // Readable with nothing in it means every writer is gone
+    int len = 0;
+    if (ioctl(fan->sourceFD, FIONREAD, &len) == -1 || len == 0) {
+        return -1;
+    }
+    int last = fan->sinkCount - 1;
+    int i;
+    for (i = 0; i < last; i++) {
+        // Each pipe was emptied in the last round and is as big as the source, so it takes all len bytes
+        if (fan->sinkFDs[i] != -1) {
+            tee(fan->sourceFD, fan->pipeFDs[i][1], len, 0);
+        }
+    }
+    for (i = 0; i < last; i++) {
+        if (fan->sinkFDs[i] != -1) {
+            spliceOut(fan, fan->pipeFDs[i][0], i, len);
+        }
+    }
+    // Moving the source into the last file takes the bytes out of it
+    spliceOut(fan, fan->sourceFD, last, len);
+    return 0;
+}
+
+/*
+* Move len bytes from a pipe into a file. A file that can't take a splice, such as a terminal, is written from a
+* buffer instead; once a file fails its bytes are read and dropped, so the other files still get theirs
+*/
+void spliceOut(struct fanout *fan, int from, int sink, size_t len) {
+    char buffer[FANOUT_COPY_SIZE];
+    while (len > 0) {
+        ssize_t moved = -1;
+        if (fan->sinkFDs[sink] != -1) {
+            moved = splice(from, NULL, fan->sinkFDs[sink], NULL, len, SPLICE_F_MOVE);
+            if (moved == -1 && errno == EINTR) {
+                continue;
+            }
+        }
+        if (moved == -1) {
+            // splice() doesn't apply; copy through the buffer, or drop the bytes of a file that has failed
+            moved = read(from, buffer, len < sizeof(buffer) ? len : sizeof(buffer));
+            if (moved <= 0) {
+                return;
+            }
+            ssize_t done = 0;
+            while (fan->sinkFDs[sink] != -1 && done < moved) {
+                ssize_t written = write(fan->sinkFDs[sink], buffer + done, moved - done);
+                if (written == -1 && errno == EINTR) {
+                    continue;
+                }
+                if (written == -1) {
+                    perror(">+ write() error!");
+                    close(fan->sinkFDs[sink]);
+                    fan->sinkFDs[sink] = -1;
+                    break;
+                }
+                done += written;
+            }
+        }
+        len -= moved;
+    }
+}
+
+/*
+* Copy what is left in a fanout's pipe once its command is done. If the pipe is still open, as when the command left
+* a process running that holds it, the rest is copied while the shell waits; otherwise the fanout is closed
+*/
+void finishFanout(int slot) {
+    struct fanout *fan = &fanouts[slot];
+    // A FIFO whose reader has gone would raise SIGPIPE, which must not end the shell
+    sigset_t pipeMask, oldMask;
+    sigemptyset(&pipeMask);
+    sigaddset(&pipeMask, SIGPIPE);
+    sigprocmask(SIG_BLOCK, &pipeMask, &oldMask);
+    struct pollfd pollFD = {fan->sourceFD, POLLIN, 0};
+    int ended = 0;
+    while (!ended && poll(&pollFD, 1, 0) == 1) {
+        ended = pumpFanout(fan) == -1;
+    }
+    struct timespec noWait = {0, 0};
+    while (sigtimedwait(&pipeMask, NULL, &noWait) > 0) {
+        continue;
+    }
+    sigprocmask(SIG_SETMASK, &oldMask, NULL);
+    if (ended) {
+        closeFanout(fan);
+    }
+}
+
+/*
+* Fill pollFDs with the source pipe of each fanout; returns the number of entries
+*/
+int pollFanouts(struct pollfd *pollFDs) {
+    int i, count = 0;
+    for (i = 0; i < FANOUT_LIMIT; i++) {
+        if (fanouts[i].sourceFD != -1) {
+            pollFDs[count].fd = fanouts[i].sourceFD;
+            pollFDs[count].events = POLLIN;
+            pollFDs[count].revents = 0;
+            count++;
+        }
+    }
+    return count;
+}
+
+/*
+* Copy the output of the fanouts that poll() found ready, closing the ones that reached end of file
+*/
+void pumpFanouts(struct pollfd *pollFDs, int count) {
+    int i, slot;
+    for (i = 0; i < count; i++) {
+        if (pollFDs[i].revents == 0) {
+            continue;
+        }
+        for (slot = 0; slot < FANOUT_LIMIT; slot++) {
+            if (fanouts[slot].sourceFD == pollFDs[i].fd) {
+                finishFanout(slot);
+            }
+        }
+    }
+}
+
+/*
+* Close a fanout's pipes and files and free its slot
+*/
+void closeFanout(struct fanout *fan) {
+    int i;
+    for (i = 0; i < fan->sinkCount; i++) {
+        if (fan->sinkFDs[i] != -1) {
+            close(fan->sinkFDs[i]);
+        }
+        if (i < fan->sinkCount - 1 && fan->pipeFDs[i][0] != -1) {
+            close(fan->pipeFDs[i][0]);
+            close(fan->pipeFDs[i][1]);
+        }
+    }
+    fan->sinkCount = 0;
+    if (fan->sourceFD != -1) {
+        close(fan->sourceFD);
+        fan->sourceFD = -1;
+        fanoutCount--;
+    }
+}
+
+/*
+* Print how a background process ended
+*/
+void reportBackground(int childPid, int childExitStatus) {
+    childExitStatus = timeoutStatus(childPid, childExitStatus);
+    recordReap(childPid, childExitStatus);
+    if (WIFEXITED(childExitStatus)) {
+        // Child background process terminated normally, print result to the terminal
+        printf("background pid %d is done: exit value %d\n", childPid, WEXITSTATUS(childExitStatus));
+        fflush(stdout);
+    }
+    else if (WIFSIGNALED(childExitStatus)) {
+        // Child background process terminated abnormally, print result to the terminal
+        printf("background pid %d is done: terminated by signal %d\n", childPid, WTERMSIG(childExitStatus));
+        fflush(stdout);
+    }
+}
+
+/*
+* Stop the background jobs before the shell exits: each job's process group gets SIGHUP and SIGTERM, and any job
+* still running after timeout seconds gets SIGKILL. With detach, the jobs are left running.
+*/
+void shutdownJobs(int timeout, _Bool detach) {
+    // Take reaping over from the backend, then report the jobs that already finished
+    reaper->stop();
+    checkBackground();
+
+    // Jobs that never started are dropped
+    if (queueCount > 0) {
+        printf("shutdown: %d queued job%s discarded\n", queueCount, queueCount == 1 ? "" : "s");
+        fflush(stdout);
+        while (queueCount > 0) {
+            free(popJob());
+        }
+    }
+
+    // Collect the jobs still running
+    pid_t pids[PROCESS_LIMIT];
+    int pidFDs[PROCESS_LIMIT];
+    int i, count = 0;
+    for (i = 0; i < PROCESS_LIMIT; i++) {
+        if (inputs.backgroundPids[i] != 0) {
+            pids[count] = inputs.backgroundPids[i];
+            count++;
+        }
+    }
+    if (count == 0) {
+        return;
+    }
+    if (detach) {
+        printf("leaving %d background job%s running\n", count, count == 1 ? "" : "s");
+        fflush(stdout);
+        return;
+    }
+
+    // Ask every job to stop; a pidfd for each lets one poll() wait for all of them with a deadline
+    for (i = 0; i < count; i++) {
+        kill(-pids[i], SIGHUP);
+        kill(-pids[i], SIGTERM);
+#ifdef SYS_pidfd_open
+        pidFDs[i] = syscall(SYS_pidfd_open, pids[i], 0);
+#else
+        pidFDs[i] = -1;
+#endif
+    }
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += timeout;
+    int remaining = waitJobs(pids, pidFDs, count, &deadline);
+
+    // Kill whatever ignored SIGTERM, and give it a second to be reaped
+    int killed = remaining;
+    if (remaining > 0) {
+        for (i = 0; i < count; i++) {
+            if (pids[i] != 0) {
+                kill(-pids[i], SIGKILL);
+            }
+        }
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_sec += 1;
+        remaining = waitJobs(pids, pidFDs, count, &deadline);
+    }
+    for (i = 0; i < count; i++) {
+        if (pidFDs[i] != -1) {
+            close(pidFDs[i]);
+        }
+    }
+
+    printf("shutdown: %d background job%s stopped", count - killed, count - killed == 1 ? "" : "s");
+    // The deadline only matters if it ran out
+    if (killed > 0) {
+        printf(", %d killed after %d second%s", killed, timeout, timeout == 1 ? "" : "s");
+    }
+    if (remaining > 0) {
+        printf(", %d still not reaped", remaining);
+    }
+    printf("\n");
+    fflush(stdout);
+}
+
+/*
+* Reap jobs as they end until all are gone or the deadline passes; reaped jobs are cleared from pids.
+* Returns the number of jobs still running
+*/
+int waitJobs(pid_t *pids, int *pidFDs, int count, struct timespec *deadline) {
+    struct pollfd pollFDs[PROCESS_LIMIT];
+    while (1) {
+        // Reap every job that has ended
+        int i, remaining = 0, polled = 0;
+        for (i = 0; i < count; i++) {
+            if (pids[i] == 0) {
+                continue;
+            }
+            int childExitStatus;
+            pid_t result = waitpid(pids[i], &childExitStatus, WNOHANG);
+            if (result > 0 || (result == -1 && errno == ECHILD)) {
+                if (result > 0) {
+                    reportBackground(pids[i], childExitStatus);
+                }
+                clearBackground(pids[i]);
+                pids[i] = 0;
+                continue;
+            }
+            remaining++;
+            if (pidFDs[i] != -1) {
+                pollFDs[polled].fd = pidFDs[i];
+                pollFDs[polled].events = POLLIN;
+                polled++;
+            }
+        }
+        if (remaining == 0) {
+            return 0;
+        }
+
+        // Sleep until a job ends or the deadline passes; jobs without a pidfd are checked every 10ms
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        long waitMs = (deadline->tv_sec - now.tv_sec) * 1000 + (deadline->tv_nsec - now.tv_nsec) / 1000000;
+        if (waitMs <= 0) {
+            return remaining;
+        }
+        if (polled < remaining && waitMs > 10) {
+            waitMs = 10;
+        }
+        poll(pollFDs, polled, waitMs);
+    }
+}
+
+/*
+* Remove a process from the background PID array
+*/
+void clearBackground(pid_t childPid) {
+    int i;
+    for (i = 0; i < PROCESS_LIMIT; i++) {
+        if (inputs.backgroundPids[i] == childPid) {
+            inputs.backgroundPids[i] = 0;
+        }
+    }
+}
+
+/*
+* Store a background process or coprocess in the first free slot of the background PID array
+*/
+void addBackground(pid_t childPid, _Bool coproc) {
+    int i;
+    for (i = 0; i < PROCESS_LIMIT; i++) {
+        if (inputs.backgroundPids[i] == 0) {
+            inputs.backgroundPids[i] = childPid;
+            inputs.backgroundCoproc[i] = coproc;
+            formatArgs(inputs.backgroundNames[i], inputs.args);
+            recordLaunch(childPid, i);
+            return;
+        }
+    }
+    printf("smallsh: more than %d background processes, pid %d is not tracked\n", PROCESS_LIMIT, childPid);
+    fflush(stdout);
+}
+
+/*
+* Count the background commands currently running, for maxjobs; coprocesses are long-lived helpers, not jobs waiting to
+* finish, so they are left out
+*/
+int countRunning(void) {
+    int i, count = 0;
+    for (i = 0; i < PROCESS_LIMIT; i++) {
+        if (inputs.backgroundPids[i] != 0 && !inputs.backgroundCoproc[i]) {
+            count++;
+        }
+    }
+    return count;
+}
+
+/*
+* Make the running background jobs give way to the foreground command: SCHED_IDLE, the highest nice value and the idle
+* I/O class for every process in each job's process group, found by walking /proc. Only the I/O class is changed if
+* the rest could not be put back; the old settings are saved for restoreBackground()
+*/
+void lowerBackground(void) {
+    if (boostMode == BOOST_UNCHECKED) {
+        boostMode = checkBoost();
+    }
+    loweredCount = 0;
+    DIR *proc = opendir("/proc");
+    if (proc == NULL) {
+        return;
+    }
+    struct dirent *entry;
+    while ((entry = readdir(proc)) != NULL) {
+        // Only the numbered entries are processes
+        if (!isdigit((unsigned char) entry->d_name[0])) {
+            continue;
+        }
+        pid_t pid = atoi(entry->d_name);
+        pid_t group = getpgid(pid);
+        // A background job leads its own process group; the foreground command is left alone
+        if (group > 0 && group != foregroundPid && isLiveJob(group)) {
+            lowerProcess(pid, group);
+        }
+    }
+    closedir(proc);
+}
+
+/*
+* Lower one process of a background job and save its old settings; a process that has ended fails and is skipped
+*/
+void lowerProcess(pid_t pid, pid_t leader) {
+    if (loweredCount == loweredCap) {
+        loweredCap = loweredCap ? loweredCap * 2 : 16;
+        lowered = realloc(lowered, loweredCap * sizeof(struct jobPriority));
+    }
+    struct jobPriority *saved = &lowered[loweredCount];
+    saved->ioprio = syscall(SYS_ioprio_get, IOPRIO_WHO_PROCESS, pid);
+    if (saved->ioprio == -1) {
+        return;
+    }
+    if (boostMode == BOOST_FULL) {
+        saved->policy = sched_getscheduler(pid);
+        errno = 0;
+        saved->nice = getpriority(PRIO_PROCESS, pid);
+        if (saved->policy == -1 || errno != 0 || sched_getparam(pid, &saved->param) == -1) {
+            return;
+        }
+        struct sched_param param = {0};
+        sched_setscheduler(pid, SCHED_IDLE, &param);
+        setpriority(PRIO_PROCESS, pid, BACKGROUND_NICE);
+    }
+    syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, pid, IOPRIO_PRIO_VALUE(IOPRIO_CLASS_IDLE, 0));
+    saved->pid = pid;
+    saved->leader = leader;
+    loweredCount++;
+}
+
+/*
+* Give the background processes lowered by lowerBackground() their old scheduling back. Only processes still in the
+* group of a tracked job are touched, found by walking /proc again: a saved PID that has left its group may belong to
+* another process now, and while the leader is tracked it is not reaped, so its group ID can't be reused. A process
+* started in the job meanwhile inherited the lowered settings, and gets its leader's old ones
+*/
+void restoreBackground(void) {
+    if (loweredCount == 0) {
+        return;
+    }
+    DIR *proc = opendir("/proc");
+    if (proc == NULL) {
+        loweredCount = 0;
+        return;
+    }
+    struct dirent *entry;
+    while ((entry = readdir(proc)) != NULL) {
+        if (!isdigit((unsigned char) entry->d_name[0])) {
+            continue;
+        }
+        pid_t pid = atoi(entry->d_name);
+        pid_t group = getpgid(pid);
+        if (group <= 0 || group == foregroundPid || !isLiveJob(group)) {
+            continue;
+        }
+        struct jobPriority *saved = findLowered(pid, group);
+        if (saved == NULL) {
+            saved = findLowered(group, group);
+        }
+        if (saved == NULL) {
+            continue;
+        }
+        if (boostMode == BOOST_FULL) {
+            sched_setscheduler(pid, saved->policy, &saved->param);
+            setpriority(PRIO_PROCESS, pid, saved->nice);
+        }
+        syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, pid, saved->ioprio);
+    }
+    closedir(proc);
+    loweredCount = 0;
+}
+
+/*
+* Find the saved settings of a lowered process in the given job, or NULL
+*/
+struct jobPriority *findLowered(pid_t pid, pid_t leader) {
+    int i;
+    for (i = 0; i < loweredCount; i++) {
+        if (lowered[i].pid == pid && lowered[i].leader == leader) {
+            return &lowered[i];
+        }
+    }
+    return NULL;
+}
+
+/*
+* Find out whether a lowered job can be put back: leaving SCHED_IDLE and lowering the nice value again need
+* CAP_SYS_NICE or a high enough RLIMIT_NICE. A child process tries both on itself; returns BOOST_FULL if it could,
+* otherwise BOOST_IO_ONLY
+*/
+int checkBoost(void) {
+    errno = 0;
+    int nice = getpriority(PRIO_PROCESS, 0);
+    pid_t childPid = fork();
+    if (childPid == -1) {
+        return BOOST_IO_ONLY;
+    }
+    if (childPid == 0) {
+        struct sched_param param = {0};
+        if (sched_setscheduler(0, SCHED_IDLE, &param) == -1 || setpriority(PRIO_PROCESS, 0, BACKGROUND_NICE) == -1
+            || sched_setscheduler(0, SCHED_OTHER, &param) == -1 || setpriority(PRIO_PROCESS, 0, nice) == -1) {
+            _exit(1);
+        }
+        _exit(0);
+    }
+    int childExitStatus;
+    while (waitpid(childPid, &childExitStatus, 0) == -1 && errno == EINTR) {
+        continue;
+    }
+    if (WIFEXITED(childExitStatus) && WEXITSTATUS(childExitStatus) == 0) {
+        return BOOST_FULL;
+    }
+    printf("smallsh: fgboost: without CAP_SYS_NICE or a higher RLIMIT_NICE only the I/O priority of background jobs is lowered\n");
+    fflush(stdout);
+    return BOOST_IO_ONLY;
+}
+
+/*
+* Copy the expanded background command into the admission queue, to be launched when a job slot frees up
+*/
+void queueJob(int priority) {
+    // The job, its argument pointers and its strings share one allocation
+    size_t size = sizeof(struct queuedJob) + (inputs.argSize + 1 + inputs.teeCount) * sizeof(char *);
+    int i;
+    for (i = 0; i < inputs.argSize; i++) {
+        size += strlen(inputs.args[i]) + 1;
+    }
+    for (i = 0; i < inputs.teeCount; i++) {
+        size += strlen(inputs.teeFiles[i]) + 1;
+    }
+    size += inputs.inputFile != NULL ? strlen(inputs.inputFile) + 1 : 0;
+    size += inputs.inputData != NULL ? strlen(inputs.inputData) + 1 : 0;
+    size += inputs.outputFile != NULL ? strlen(inputs.outputFile) + 1 : 0;
+    struct queuedJob *job = malloc(size);
+    job->id = nextJobId;
+    nextJobId++;
+    job->priority = priority;
+    job->seq = jobSeq;
+    jobSeq++;
+    job->argCount = inputs.argSize;
+    job->args = (char **) (job + 1);
+    job->teeFiles = job->args + inputs.argSize + 1;
+    job->teeCount = inputs.teeCount;
+    char *strings = (char *) (job->teeFiles + inputs.teeCount);
+    for (i = 0; i < inputs.argSize; i++) {
+        job->args[i] = strcpy(strings, inputs.args[i]);
+        strings += strlen(strings) + 1;
+    }
+    job->args[inputs.argSize] = NULL;
+    for (i = 0; i < inputs.teeCount; i++) {
+        job->teeFiles[i] = strcpy(strings, inputs.teeFiles[i]);
+        strings += strlen(strings) + 1;
+    }
+    job->inputFile = NULL;
+    job->inputData = NULL;
+    job->outputFile = NULL;
+    job->timeoutNs = inputs.timeoutNs;
+    job->killAfterNs = inputs.killAfterNs;
+    if (inputs.inputFile != NULL) {
+        job->inputFile = strcpy(strings, inputs.inputFile);
+        strings += strlen(strings) + 1;
+    }
+    if (inputs.inputData != NULL) {
+        job->inputData = strcpy(strings, inputs.inputData);
+        strings += strlen(strings) + 1;
+    }
+    if (inputs.outputFile != NULL) {
+        job->outputFile = strcpy(strings, inputs.outputFile);
+    }
+
+    // Add the job to the heap and sift it up to its place
+    if (queueCount == queueCap) {
+        queueCap = queueCap ? queueCap * 2 : 16;
+        jobQueue = realloc(jobQueue, queueCap * sizeof(struct queuedJob *));
+    }
+    int pos = queueCount;
+    queueCount++;
+    while (pos > 0 && jobBefore(job, jobQueue[(pos - 1) / 2])) {
+        jobQueue[pos] = jobQueue[(pos - 1) / 2];
+        pos = (pos - 1) / 2;
+    }
+    jobQueue[pos] = job;
+
+    printf("background job %d is queued (priority %d)\n", job->id, priority);
+    fflush(stdout);
+}
+
+/*
+* Take the first job off the admission queue
+*/
+struct queuedJob *popJob(void) {
+    struct queuedJob *first = jobQueue[0];
+    queueCount--;
+    // Sift the last job down from the top
+    struct queuedJob *last = jobQueue[queueCount];
+    int pos = 0;
+    while (1) {
+        int child = pos * 2 + 1;
+        if (child >= queueCount) {
+            break;
+        }
+        if (child + 1 < queueCount && jobBefore(jobQueue[child + 1], jobQueue[child])) {
+            child++;
+        }
+        if (!jobBefore(jobQueue[child], last)) {
+            break;
+        }
+        jobQueue[pos] = jobQueue[child];
+        pos = child;
+    }
+    jobQueue[pos] = last;
+    return first;
+}
+
+/*
+* Order of the admission queue: higher priority first, then first come first served
+*/
+_Bool jobBefore(struct queuedJob *a, struct queuedJob *b) {
+    if (a->priority != b->priority) {
+        return a->priority > b->priority;
+    }
+    return a->seq < b->seq;
+}
+
+/*
+* Launch queued jobs while there are free job slots
+*/
+void admitQueued(void) {
+    while (queueCount > 0 && (inputs.maxJobs == 0 || countRunning() < inputs.maxJobs)) {
+        struct queuedJob *job = popJob();
+        // Run it as a background command
+        inputs.argSize = 0;
+        inputs.args[0] = NULL;
+        inputs.argBytes = 0;
+        inputs.argOverflow = 0;
+        int i;
+        for (i = 0; i < job->argCount; i++) {
+            addArg(job->args[i]);
+        }
+        inputs.inputFile = job->inputFile;
+        inputs.inputData = job->inputData;
+        inputs.outputFile = job->outputFile;
+        inputs.teeFiles = job->teeFiles;
+        inputs.teeCount = job->teeCount;
+        inputs.timeoutNs = job->timeoutNs;
+        inputs.killAfterNs = job->killAfterNs;
+        inputs.background = 1;
+        executeCommand();
+        inputs.background = 0;
+        inputs.timeoutNs = 0;
+        inputs.inputFile = NULL;
+        inputs.inputData = NULL;
+        inputs.outputFile = NULL;
+        inputs.teeCount = 0;
+        free(job);
+    }
+}
+
+/*
+* Built-in jobs: list the running background processes, then the queued jobs in the order they will run
+*/
+int jobsBuiltin(void) {
+    int i;
+    for (i = 0; i < PROCESS_LIMIT; i++) {
+        if (inputs.backgroundPids[i] != 0) {
+            printf("pid %d running: %s\n", inputs.backgroundPids[i], inputs.backgroundNames[i]);
+        }
+    }
+    // Print a sorted copy of the heap
+    struct queuedJob **sorted = malloc((queueCount + 1) * sizeof(struct queuedJob *));
+    memcpy(sorted, jobQueue, queueCount * sizeof(struct queuedJob *));
+    qsort(sorted, queueCount, sizeof(struct queuedJob *), compareJobs);
+    for (i = 0; i < queueCount; i++) {
+        char name[JOB_NAME_LENGTH];
+        formatArgs(name, sorted[i]->args);
+        printf("job %d queued (priority %d): %s\n", sorted[i]->id, sorted[i]->priority, name);
+    }
+    free(sorted);
+    fflush(stdout);
+    return 0;
+}
+
+/*
+* Compare two queued jobs for qsort()
+*/
+int compareJobs(const void *a, const void *b) {
+    struct queuedJob *jobA = *(struct queuedJob * const *) a;
+    struct queuedJob *jobB = *(struct queuedJob * const *) b;
+    return jobBefore(jobA, jobB) ? -1 : 1;
+}
+
+/*
+* Join a command's arguments with spaces into a JOB_NAME_LENGTH buffer, cutting it short if needed
+*/
+void formatArgs(char *name, char **args) {
+    int len = 0;
+    name[0] = '\0';
+    for (; *args != NULL && len < JOB_NAME_LENGTH - 1; args++) {
+        len += snprintf(name + len, JOB_NAME_LENGTH - len, "%s%s", len > 0 ? " " : "", *args);
+    }
+}
+
+/*
+* Create the shared job table: a POSIX shared memory object when name is given, else a memfd that monitors open
+* through /proc; returns -1 on failure
+*/
+int openJobTable(char *name) {
+    int tableFD;
+    if (name != NULL) {
+        // shm_open names start with a slash
+        snprintf(jobTablePath, sizeof(jobTablePath), "%s%s", name[0] == '/' ? "" : "/", name);
+        tableFD = shm_open(jobTablePath, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+        jobTableShm = 1;
+    }
+    else {
+        tableFD = syscall(SYS_memfd_create, "smallsh-jobs", MFD_CLOEXEC);
+    }
+    if (tableFD == -1 || ftruncate(tableFD, sizeof(struct jobTable)) == -1) {
+        perror("job table");
+        return -1;
+    }
+    jobTable = mmap(NULL, sizeof(struct jobTable), PROT_READ | PROT_WRITE, MAP_SHARED, tableFD, 0);
+    if (jobTable == MAP_FAILED) {
+        perror("job table mmap() error!");
+        jobTable = NULL;
+        return -1;
+    }
+    // A memfd stays open, as its /proc path is how monitors find it
+    if (name == NULL) {
+        snprintf(jobTablePath, sizeof(jobTablePath), "/proc/%d/fd/%d", getpid(), tableFD);
+    }
+    else {
+        close(tableFD);
+    }
+    // The mapping starts zeroed: every slot free, every counter 0
+    jobTable->version = JOBTABLE_VERSION;
+    jobTable->entrySize = sizeof(struct jobTableEntry);
+    jobTable->capacity = PROCESS_LIMIT;
+    jobTable->shellPid = getpid();
+    // The magic goes in last, so a monitor that sees it sees the rest of the header
+    __atomic_store_n(&jobTable->magic, JOBTABLE_MAGIC, __ATOMIC_RELEASE);
+    setenv("SMALLSH_JOBTABLE", jobTablePath, 1);
+    return 0;
+}
+
+/*
+* Start a change to the job table: the sequence number turns odd, so readers retry until jobTableEnd(). SIGCHLD is
+* held until then, so the handler can't record a reap in the middle of another change
+*/
+void jobTableBegin(void) {
+    sigset_t childMask;
+    sigemptyset(&childMask);
+    sigaddset(&childMask, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &childMask, &jobTableMask);
+    __atomic_store_n(&jobTable->seq, jobTable->seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+/*
+* Finish a change to the job table: the sequence number turns even again
+*/
+void jobTableEnd(void) {
+    __atomic_store_n(&jobTable->seq, jobTable->seq + 1, __ATOMIC_RELEASE);
+    // A SIGCHLD that came during the change is handled now
+    sigprocmask(SIG_SETMASK, &jobTableMask, NULL);
+}
+
+/*
+* Fill a job table entry for a process that just started
+*/
+void fillJobEntry(struct jobTableEntry *entry, pid_t pid) {
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    entry->pid = pid;
+    entry->state = JOB_RUNNING;
+    entry->exitStatus = 0;
+    entry->startTime = (int64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+    entry->endTime = 0;
+    formatArgs(entry->command, inputs.args);
+}
+
+/*
+* Mark a job table entry as ended with the given wait status
+*/
+void endJobEntry(struct jobTableEntry *entry, int childExitStatus) {
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    entry->state = WIFSIGNALED(childExitStatus) ? JOB_SIGNALED : JOB_EXITED;
+    entry->exitStatus = WIFSIGNALED(childExitStatus) ? WTERMSIG(childExitStatus) : WEXITSTATUS(childExitStatus);
+    entry->endTime = (int64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+/*
+* Publish a launched command: background processes take the slot they have in the background PID array
+*/
+void recordLaunch(pid_t childPid, int slot) {
+    if (jobTable == NULL) {
+        return;
+    }
+    jobTableBegin();
+    if (slot >= 0) {
+        fillJobEntry(&jobTable->jobs[slot], childPid);
+    }
+    else {
+        fillJobEntry(&jobTable->foreground, childPid);
+    }
+    jobTableEnd();
+    __atomic_fetch_add(&jobTable->launches, 1, __ATOMIC_RELAXED);
+}
+
+/*
+* Publish how a background process ended. Only writes memory and sets the signal mask, so the SIGCHLD handler can call it
+*/
+void recordReap(pid_t childPid, int childExitStatus) {
+    if (jobTable == NULL) {
+        return;
+    }
+    int i;
+    for (i = 0; i < PROCESS_LIMIT; i++) {
+        if (jobTable->jobs[i].pid == childPid && jobTable->jobs[i].state == JOB_RUNNING) {
+            jobTableBegin();
+            endJobEntry(&jobTable->jobs[i], childExitStatus);
+            jobTableEnd();
+            __atomic_fetch_add(&jobTable->reaps, 1, __ATOMIC_RELAXED);
+            return;
+        }
+    }
+}
+
+/*
+* Publish how the foreground process ended
+*/
+void recordForeground(int childExitStatus) {
+    if (jobTable == NULL) {
+        return;
+    }
+    jobTableBegin();
+    endJobEntry(&jobTable->foreground, childExitStatus);
+    jobTableEnd();
+}
+
+/*
+* Count a command that failed to start; called in the child, which shares the mapping until it execs
+*/
+void recordFailure(void) {
+    if (jobTable != NULL) {
+        __atomic_fetch_add(&jobTable->failures, 1, __ATOMIC_RELAXED);
+    }
+}
+
+/*
+* Count a command stopped by its timeout
+*/
+void recordTimeout(void) {
+    if (jobTable != NULL) {
+        __atomic_fetch_add(&jobTable->timeouts, 1, __ATOMIC_RELAXED);
+    }
+}
+
+/*
+* Take the job table down when the shell exits; a memfd goes away with the process
+*/
+void closeJobTable(void) {
+    if (jobTable == NULL) {
+        return;
+    }
+    jobTableBegin();
+    jobTable->shellPid = 0;
+    jobTableEnd();
+    if (jobTableShm) {
+        shm_unlink(jobTablePath);
+    }
+}
+
+/*
+* Current CLOCK_MONOTONIC time in nanoseconds
+*/
+long long monotonicNow(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long) now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+/*
+* Add a deadline to the heap: send signal to pid at expiry (CLOCK_MONOTONIC nanoseconds), then SIGKILL killAfter
+* nanoseconds later if killAfter is set
+*/
+void addDeadline(pid_t pid, long long expiry, int signal, long long killAfter) {
+    // The one timerfd for all deadlines is created the first time it is needed
+    if (timerFD == -1) {
+        timerFD = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+        if (timerFD == -1) {
+            perror("timerfd_create() error!");
+            return;
+        }
+    }
+    if (deadlineCount == deadlineCap) {
+        deadlineCap = deadlineCap ? deadlineCap * 2 : 16;
+        deadlines = realloc(deadlines, deadlineCap * sizeof(struct deadline));
+    }
+    // Sift the new deadline up to its place in the min-heap
+    int pos = deadlineCount;
+    deadlineCount++;
+    while (pos > 0 && deadlines[(pos - 1) / 2].expiry > expiry) {
+        deadlines[pos] = deadlines[(pos - 1) / 2];
+        pos = (pos - 1) / 2;
+    }
+    deadlines[pos] = (struct deadline) {pid, signal, expiry, killAfter};
+    armTimer();
+}
+
+/*
+* Remove the earliest deadline from the heap
+*/
+struct deadline popDeadline(void) {
+    struct deadline first = deadlines[0];
+    deadlineCount--;
+    siftDeadline(0, deadlines[deadlineCount]);
+    return first;
+}
+
+/*
+* Place a deadline at pos and sift it down to where it belongs
+*/
+void siftDeadline(int pos, struct deadline entry) {
+    while (1) {
+        int child = pos * 2 + 1;
+        if (child >= deadlineCount) {
+            break;
+        }
+        if (child + 1 < deadlineCount && deadlines[child + 1].expiry < deadlines[child].expiry) {
+            child++;
+        }
+        if (deadlines[child].expiry >= entry.expiry) {
+            break;
+        }
+        deadlines[pos] = deadlines[child];
+        pos = child;
+    }
+    if (deadlineCount > 0) {
+        deadlines[pos] = entry;
+    }
+}
+
+/*
+* Drop every deadline of a process that has ended
+*/
+void removeDeadlines(pid_t pid) {
+    int i, kept = 0;
+    for (i = 0; i < deadlineCount; i++) {
+        if (deadlines[i].pid != pid) {
+            deadlines[kept] = deadlines[i];
+            kept++;
+        }
+    }
+    if (kept == deadlineCount) {
+        return;
+    }
+    // Rebuild the heap from the deadlines that are left
+    deadlineCount = kept;
+    for (i = deadlineCount / 2 - 1; i >= 0; i--) {
+        siftDeadline(i, deadlines[i]);
+    }
+    armTimer();
+}
+
+/*
+* Arm the timerfd for the earliest deadline, or disarm it if there are none
+*/
+void armTimer(void) {
+    struct itimerspec timer;
+    memset(&timer, 0, sizeof(timer));
+    if (deadlineCount > 0) {
+        // An expiry of zero would disarm the timer, so an expired deadline is set to fire right away
+        long long expiry = deadlines[0].expiry > 0 ? deadlines[0].expiry : 1;
+        timer.it_value.tv_sec = expiry / 1000000000LL;
+        timer.it_value.tv_nsec = expiry % 1000000000LL;
+    }
+    timerfd_settime(timerFD, TFD_TIMER_ABSTIME, &timer, NULL);
+}
+
+/*
+* Handle the timerfd firing: signal every process whose deadline has passed, scheduling SIGKILL where asked
+*/
+void fireDeadlines(void) {
+    uint64_t expirations;
+    read(timerFD, &expirations, sizeof(expirations));
+    long long now = monotonicNow();
+    while (deadlineCount > 0 && deadlines[0].expiry <= now) {
+        struct deadline entry = popDeadline();
+        // Only signal processes the shell is still waiting on, in case the PID was reused
+        if (!isLiveJob(entry.pid)) {
+            continue;
+        }
+        // Mark it first, so a SIGCHLD handler that reaps it right away sees the mark
+        markTimedOut(entry.pid);
+        // Background processes lead their own process group, so the whole job is signalled
+        kill(entry.pid == foregroundPid ? entry.pid : -entry.pid, entry.signal);
+        if (entry.killAfter > 0) {
+            addDeadline(entry.pid, now + entry.killAfter, SIGKILL, 0);
+        }
+    }
+    armTimer();
+}
+
+/*
+* Check whether pid is the foreground process or a running background process
+*/
+_Bool isLiveJob(pid_t pid) {
+    int i;
+    if (pid == foregroundPid) {
+        return 1;
+    }
+    for (i = 0; i < PROCESS_LIMIT; i++) {
+        if (inputs.backgroundPids[i] == pid) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+* Remember that a process was stopped by its timeout
+*/
+void markTimedOut(pid_t pid) {
+    int i;
+    for (i = 0; i < PROCESS_LIMIT; i++) {
+        if (timedOutPids[i] == pid) {
+            return;
+        }
+    }
+    timedOutPids[timedOutNext] = pid;
+    timedOutNext = (timedOutNext + 1) % PROCESS_LIMIT;
+    recordTimeout();
+}
+
+/*
+* Give a process stopped by its timeout the status timeout(1) would: 124, or 137 if it took SIGKILL.
+* Only scans and writes an array, so it is safe to call from a signal handler
+*/
+int timeoutStatus(pid_t pid, int childExitStatus) {
+    int i;
+    for (i = 0; i < PROCESS_LIMIT; i++) {
+        if (timedOutPids[i] == pid) {
+            timedOutPids[i] = 0;
+            if (WIFSIGNALED(childExitStatus) && WTERMSIG(childExitStatus) == SIGKILL) {
+                return W_EXITCODE(128 + SIGKILL, 0);
+            }
+            return W_EXITCODE(TIMEOUT_STATUS, 0);
+        }
+    }
+    return childExitStatus;
+}
+
+/*
+* Wait for the foreground process; while deadlines are pending or jobs are queued, wait on a pidfd, the timerfd and the
+* reaping backend together so the deadlines fire on time and queued jobs start as soon as a slot frees
+*/
+pid_t waitForeground(pid_t childPid, int *childExitStatus) {
+    pid_t waitPid;
+    foregroundPid = childPid;
+    if (deadlineCount == 0 && fanoutCount == 0 && queueCount == 0) {
+        // Block in waitpid, waiting again if a signal handler interrupts
+        do {
+            waitPid = waitpid(childPid, childExitStatus, 0);
+        } while (waitPid == -1 && errno == EINTR);
+    }
+    else {
+        int pidFD = -1;
+#ifdef SYS_pidfd_open
+        pidFD = syscall(SYS_pidfd_open, childPid, 0);
+#endif
+        while (1) {
+            waitPid = waitpid(childPid, childExitStatus, WNOHANG);
+            if (waitPid != 0 && !(waitPid == -1 && errno == EINTR)) {
+                break;
+            }
+            // Without a pidfd, check on the process every 10ms, as the poll backend does with queued jobs; ">+" outputs
+            // are copied meanwhile
+            struct pollfd pollFDs[3 + FANOUT_LIMIT] = {{timerFD, POLLIN, 0}, {pidFD, POLLIN, 0}, {reaperFD, POLLIN, 0}};
+            int fanPolls = pollFanouts(pollFDs + 3);
+            _Bool pollReaper = reaperFD == -1 && queueCount > 0;
+            poll(pollFDs, 3 + fanPolls, pidFD == -1 || pollReaper ? 10 : -1);
+            if (pollFDs[0].revents & POLLIN) {
+                fireDeadlines();
+            }
+            pumpFanouts(pollFDs + 3, fanPolls);
+            // A background job ended: report it and launch queued jobs into its slot
+            if ((pollFDs[2].revents & POLLIN) || pollReaper) {
+                reapBackground();
+            }
+        }
+        if (pidFD != -1) {
+            close(pidFD);
+        }
+    }
+    foregroundPid = 0;
+    removeDeadlines(childPid);
+    if (waitPid > 0) {
+        *childExitStatus = timeoutStatus(childPid, *childExitStatus);
+    }
+    return waitPid;
+}
+
+/*
+* Block until stdin has input, firing deadlines that come due and copying ">+" output in the meantime; returns -1 with
+* errno EINTR if a signal handler interrupts or the reaping backend has background processes to reap, otherwise 0
+*/
+int waitForInput(void) {
+    while (deadlineCount > 0 || reaperFD != -1 || fanoutCount > 0) {
+        // poll() skips entries whose descriptor is -1; background ">+" outputs are copied while the shell waits
+        struct pollfd pollFDs[3 + FANOUT_LIMIT] = {{STDIN_FILENO, POLLIN, 0}, {timerFD, POLLIN, 0}, {reaperFD, POLLIN, 0}};
+        int fanPolls = pollFanouts(pollFDs + 3);
+        if (poll(pollFDs, 3 + fanPolls, -1) == -1) {
+            return errno == EINTR ? -1 : 0;
+        }
+        if (pollFDs[1].revents & POLLIN) {
+            fireDeadlines();
+        }
+        pumpFanouts(pollFDs + 3, fanPolls);
+        if (pollFDs[2].revents & POLLIN) {
+            errno = EINTR;
+            return -1;
+        }
+        if (pollFDs[0].revents) {
+            return 0;
+        }
+    }
+    return 0;
+}
+
+/*
+* Check whether stdio already holds unread input, so waiting on the descriptor would miss it
+*/
+_Bool stdinBuffered(void) {
+#ifdef __GLIBC__
+    return stdin->_IO_read_ptr < stdin->_IO_read_end;
+#else
+    // Without a way to tell, read as before
+    return 1;
+#endif
+}
+
+/*
+* Parse a timeout(1) style duration: a number with an optional s, m, h or d suffix; returns nanoseconds, or -1 if it
+* is malformed, infinite, not a number, or too long to count in nanoseconds
+*/
+long long parseDuration(char *text) {
+    char *end;
+    double value = strtod(text, &end);
+    if (end == text || !isfinite(value) || value < 0) {
+        return -1;
+    }
+    double scale = 1;
+    if (*end == 'm') scale = 60;
+    else if (*end == 'h') scale = 3600;
+    else if (*end == 'd') scale = 86400;
+    else if (*end != 's' && *end != '\0') return -1;
+    if (*end != '\0' && end[1] != '\0') {
+        return -1;
+    }
+    // LLONG_MAX rounds up to 2^63 as a double, so anything that large can't be converted
+    double ns = value * scale * 1e9;
+    if (ns >= (double) LLONG_MAX) {
+        return -1;
+    }
+    return (long long) ns;
+}
+
+/*
+* Built-in timeout: "timeout DURATION [-k KILL_AFTER] COMMAND...". Takes the timeout off the front of args and sets
+* the deadline for the command that follows; returns -1 on bad usage
+*/
+int timeoutBuiltin(void) {
+    int first = 1;
+    inputs.killAfterNs = 0;
+    // Options may come before or after the duration
+    while (first < inputs.argSize && inputs.args[first][0] == '-' && inputs.args[first][1] != '\0') {
+        if (strcmp(inputs.args[first], "-k") == 0 && first + 1 < inputs.argSize) {
+            inputs.killAfterNs = parseDuration(inputs.args[first + 1]);
+            first += 2;
+        }
+        else if (strncmp(inputs.args[first], "--kill-after=", 13) == 0) {
+            inputs.killAfterNs = parseDuration(inputs.args[first] + 13);
+            first++;
+        }
+        else {
+            break;
+        }
+    }
+    if (first >= inputs.argSize || inputs.killAfterNs < 0) {
+        return timeoutUsage();
+    }
+    inputs.timeoutNs = parseDuration(inputs.args[first]);
+    first++;
+    if (first + 1 < inputs.argSize && strcmp(inputs.args[first], "-k") == 0) {
+        inputs.killAfterNs = parseDuration(inputs.args[first + 1]);
+        first += 2;
+    }
+    if (inputs.timeoutNs < 0 || inputs.killAfterNs < 0 || first >= inputs.argSize) {
+        inputs.timeoutNs = 0;
+        return timeoutUsage();
+    }
+    // The command is what follows, including the terminating NULL
+    memmove(inputs.args, inputs.args + first, (inputs.argSize - first + 1) * sizeof(inputs.args[0]));
+    inputs.argSize -= first;
+    return 0;
+}
+
+/*
+* Print the usage of the timeout built-in and return -1
+*/
+int timeoutUsage(void) {
+    printf("smallsh: timeout: usage: timeout DURATION [-k KILL_AFTER] COMMAND [ARG]...\n");
+    fflush(stdout);
+    return -1;
+}
+
+/*
+* Built-in coproc: "coproc" lists the coprocesses, "coproc NAME COMMAND [ARG]..." starts COMMAND as a background job
+* that keeps running, reading lines sent with coproc-send and answering through coproc-read
+*/
+int coprocBuiltin(void) {
+    int i;
+    if (inputs.argSize == 1) {
+        for (i = 0; i < COPROC_LIMIT; i++) {
+            if (coprocs[i].name[0] != '\0') {
+                printf("%s pid %d %s\n", coprocs[i].name, coprocs[i].pid, isLiveJob(coprocs[i].pid) ? "running" : "done");
+            }
+        }
+        fflush(stdout);
+        return 0;
+    }
+    if (inputs.argSize < 3 || !isName(inputs.args[1], strlen(inputs.args[1])) || strlen(inputs.args[1]) >= JOB_NAME_LENGTH) {
+        printf("smallsh: coproc: usage: coproc [NAME COMMAND [ARG]...]\n");
+        fflush(stdout);
+        return 1;
+    }
+    // A name can be used again once its process has ended
+    struct coprocess *coproc = findCoproc(inputs.args[1]);
+    if (coproc != NULL && isLiveJob(coproc->pid)) {
+        printf("smallsh: coproc: %s is already running as pid %d\n", coproc->name, coproc->pid);
+        fflush(stdout);
+        return 1;
+    }
+    if (coproc != NULL) {
+        closeCoproc(coproc);
+    }
+    for (i = 0; i < COPROC_LIMIT && coproc == NULL; i++) {
+        if (coprocs[i].name[0] == '\0') {
+            coproc = &coprocs[i];
+        }
+    }
+    if (coproc == NULL) {
+        printf("smallsh: coproc: more than %d coprocesses\n", COPROC_LIMIT);
+        fflush(stdout);
+        return 1;
+    }
+    return startCoproc(coproc, inputs.args + 2) == 0 ? 0 : 1;
+}
+
+/*
+* Built-in coproc-send: "coproc-send NAME [WORD]..." writes the words, separated by spaces, as one line to the
+* coprocess's stdin
+*/
+int coprocSendBuiltin(void) {
+    struct coprocess *coproc = inputs.argSize < 2 ? NULL : findCoproc(inputs.args[1]);
+    if (coproc == NULL) {
+        printf("smallsh: coproc-send: usage: coproc-send NAME [WORD]...; NAME must be a coprocess\n");
+        fflush(stdout);
+        return 1;
+    }
+    // Join the words into one line in the arena
+    size_t len = 0;
+    int i;
+    for (i = 2; i < inputs.argSize; i++) {
+        len += strlen(inputs.args[i]) + 1;
+    }
+    char *line = arenaAlloc(len + 1);
+    len = 0;
+    for (i = 2; i < inputs.argSize; i++) {
+        size_t wordLen = strlen(inputs.args[i]);
+        memcpy(line + len, inputs.args[i], wordLen);
+        len += wordLen;
+        line[len++] = ' ';
+    }
+    if (len == 0) {
+        len = 1;
+    }
+    line[len - 1] = '\n';
+
+    // A coprocess that has ended would kill the shell with SIGPIPE, so hold it and take it back if it was raised
+    sigset_t pipeMask, oldMask;
+    sigemptyset(&pipeMask);
+    sigaddset(&pipeMask, SIGPIPE);
+    sigprocmask(SIG_BLOCK, &pipeMask, &oldMask);
+    size_t done = 0;
+    ssize_t written = 0;
+    while (done < len) {
+        written = write(coproc->toFD, line + done, len - done);
+        if (written == -1 && errno == EINTR) {
+            continue;
+        }
+        if (written == -1) {
+            break;
+        }
+        done += written;
+    }
+    if (written == -1) {
+        int savedErrno = errno;
+        struct timespec noWait = {0, 0};
+        sigtimedwait(&pipeMask, NULL, &noWait);
+        errno = savedErrno;
+        fprintf(stderr, "smallsh: coproc-send: %s: %s\n", coproc->name, strerror(errno));
+    }
+    sigprocmask(SIG_SETMASK, &oldMask, NULL);
+    return written == -1 ? 1 : 0;
+}
+
+/*
+* Built-in coproc-read: "coproc-read NAME [VAR]" reads one line from the coprocess's stdout into VAR, or prints it.
+* Under "timeout DURATION" it gives up after DURATION with exit value 124, and on Ctrl-C with 130; at end of file the
+* exit value is 1. The exit value is what status shows
+*/
+int coprocReadBuiltin(void) {
+    inputs.signalTerm = 0;
+    struct coprocess *coproc = inputs.argSize < 2 || inputs.argSize > 3 ? NULL : findCoproc(inputs.args[1]);
+    if (coproc == NULL || (inputs.argSize == 3 && !isName(inputs.args[2], strlen(inputs.args[2])))) {
+        printf("smallsh: coproc-read: usage: coproc-read NAME [VAR]; NAME must be a coprocess\n");
+        fflush(stdout);
+        inputs.exitStatus = 1;
+        return 1;
+    }
+    char *line;
+    inputs.exitStatus = readCoprocLine(coproc, &line);
+    if (inputs.exitStatus != 0) {
+        return inputs.exitStatus;
+    }
+    if (inputs.argSize == 3) {
+        setVar(inputs.args[2], line);
+    }
+    else {
+        printf("%s\n", line);
+        fflush(stdout);
+    }
+    return 0;
+}
+
+/*
+* Built-in coproc-close: "coproc-close NAME" closes the pipes to and from a coprocess, so it reads end of file and can
+* finish; it is reaped and reported like any background job
+*/
+int coprocCloseBuiltin(void) {
+    struct coprocess *coproc = inputs.argSize != 2 ? NULL : findCoproc(inputs.args[1]);
+    if (coproc == NULL) {
+        printf("smallsh: coproc-close: usage: coproc-close NAME; NAME must be a coprocess\n");
+        fflush(stdout);
+        return 1;
+    }
+    closeCoproc(coproc);
+    return 0;
+}
+
+/*
+* Look up a coprocess by name; returns NULL if there is none
+*/
+struct coprocess *findCoproc(char *name) {
+    int i;
+    for (i = 0; i < COPROC_LIMIT; i++) {
+        if (coprocs[i].name[0] != '\0' && strcmp(coprocs[i].name, name) == 0) {
+            return &coprocs[i];
+        }
+    }
+    return NULL;
+}
+
+/*
+* Start a coprocess in the given slot, named by args[-1], running args with its stdin and stdout on pipes kept by the
+* shell. Like a background command it gets its own process group and is tracked by the reaping backend
+*/
+int startCoproc(struct coprocess *coproc, char **args) {
+    // The shell's ends are close-on-exec, so commands started later don't hold the coprocess's stdin open
+    int toPipe[2], fromPipe[2];
+    if (pipe2(toPipe, O_CLOEXEC) == -1) {
+        perror("pipe2() error!");
+        return -1;
+    }
+    if (pipe2(fromPipe, O_CLOEXEC) == -1) {
+        perror("pipe2() error!");
+        close(toPipe[0]);
+        close(toPipe[1]);
+        return -1;
+    }
+
+    // Hold SIGCHLD until the process is stored, so a SIGCHLD handler can't reap it first
+    sigset_t childMask, oldMask;
+    sigemptyset(&childMask);
+    sigaddset(&childMask, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &childMask, &oldMask);
+    fflush(stdout);
+    pid_t childPid = fork();
+    if (childPid == -1) {
+        perror("fork() error!");
+        sigprocmask(SIG_SETMASK, &oldMask, NULL);
+        close(toPipe[0]);
+        close(toPipe[1]);
+        close(fromPipe[0]);
+        close(fromPipe[1]);
+        return -1;
+    }
+    if (childPid == 0) {
+        // dup2 clears close-on-exec on the copies, so only stdin and stdout stay open across exec
+        if (dup2(toPipe[0], STDIN_FILENO) == -1 || dup2(fromPipe[1], STDOUT_FILENO) == -1) {
+            perror("coproc dup2() error!");
+            exit(1);
+        }
+        setpgid(0, 0);
+        sigaction(SIGINT, &defaultAction, NULL);
+        sigprocmask(SIG_UNBLOCK, &childMask, NULL);
+        execvp(args[0], args);
+        perror(args[0]);
+        recordFailure();
+        exit(1);
+    }
+    setpgid(childPid, childPid);
+    close(toPipe[0]);
+    close(fromPipe[1]);
+
+    strcpy(coproc->name, args[-1]);
+    coproc->pid = childPid;
+    coproc->toFD = toPipe[1];
+    coproc->fromFD = fromPipe[0];
+    coproc->len = 0;
+    coproc->cap = COPROC_BUFFER_INITIAL;
+    coproc->buffer = malloc(coproc->cap);
+    coproc->ended = 0;
+
+    // Listed by jobs, reported when it ends and stopped at exit like any background job
+    printf("coprocess %s pid is: %d\n", coproc->name, childPid);
+    fflush(stdout);
+    addBackground(childPid, 1);
+    reaper->track(childPid);
+    sigprocmask(SIG_SETMASK, &oldMask, NULL);
+    return 0;
+}
+
+/*
+* Take the next line of a coprocess's output, without its newline, reading more from the pipe as needed. The line is
+* in the arena. Returns 0, 1 at end of file, TIMEOUT_STATUS if the timeout built-in's deadline passes first, or 130
+* (128 + SIGINT) if the user interrupts the wait
+*/
+int readCoprocLine(struct coprocess *coproc, char **line) {
+    long long expiry = inputs.timeoutNs > 0 ? monotonicNow() + inputs.timeoutNs : 0;
+    // SIGINT is caught while waiting; it is held outside ppoll(), so one that comes between checks is not missed
+    sigset_t intMask, oldMask, waitMask;
+    sigemptyset(&intMask);
+    sigaddset(&intMask, SIGINT);
+    sigprocmask(SIG_BLOCK, &intMask, &oldMask);
+    waitMask = oldMask;
+    sigdelset(&waitMask, SIGINT);
+    struct sigaction oldAction;
+    interrupted = 0;
+    sigaction(SIGINT, &actionSIGINT, &oldAction);
+    int result;
+    size_t scanned = 0;
+    while (1) {
+        // A whole line is in the buffer, or the output ended with a last line that has no newline
+        char *newline = memchr(coproc->buffer + scanned, '\n', coproc->len - scanned);
+        if (newline != NULL || (coproc->ended && coproc->len > 0)) {
+            size_t lineLen = newline != NULL ? (size_t) (newline - coproc->buffer) : coproc->len;
+            size_t used = newline != NULL ? lineLen + 1 : lineLen;
+            *line = arenaAlloc(lineLen + 1);
+            memcpy(*line, coproc->buffer, lineLen);
+            (*line)[lineLen] = '\0';
+            memmove(coproc->buffer, coproc->buffer + used, coproc->len - used);
+            coproc->len -= used;
+            result = 0;
+            break;
+        }
+        if (coproc->ended) {
+            result = 1;
+            break;
+        }
+        scanned = coproc->len;
+        if (interrupted) {
+            result = 128 + SIGINT;
+            break;
+        }
+
+        // Wait for more output, up to the deadline; a signal or the deadline brings the loop back to the checks above
+        struct timespec wait, *waitPtr = NULL;
+        if (expiry > 0) {
+            long long left = expiry - monotonicNow();
+            if (left <= 0) {
+                recordTimeout();
+                result = TIMEOUT_STATUS;
+                break;
+            }
+            wait.tv_sec = left / 1000000000LL;
+            wait.tv_nsec = left % 1000000000LL;
+            waitPtr = &wait;
+        }
+        struct pollfd pollFD = {coproc->fromFD, POLLIN, 0};
+        if (ppoll(&pollFD, 1, waitPtr, &waitMask) <= 0) {
+            continue;
+        }
+        if (coproc->len == coproc->cap) {
+            coproc->cap *= 2;
+            coproc->buffer = realloc(coproc->buffer, coproc->cap);
+        }
+        ssize_t numBytes = read(coproc->fromFD, coproc->buffer + coproc->len, coproc->cap - coproc->len);
+        if (numBytes == -1 && errno == EINTR) {
+            continue;
+        }
+        if (numBytes <= 0) {
+            coproc->ended = 1;
+            continue;
+        }
+        coproc->len += numBytes;
+    }
+    // Ignoring SIGINT again discards one still pending, before it is let through
+    sigaction(SIGINT, &oldAction, NULL);
+    sigprocmask(SIG_SETMASK, &oldMask, NULL);
+    return result;
+}
+
+/*
+* Close a coprocess's pipes and free its slot; the process itself is left to the reaping backend
+*/
+void closeCoproc(struct coprocess *coproc) {
+    if (coproc->name[0] == '\0') {
+        return;
+    }
+    close(coproc->toFD);
+    close(coproc->fromFD);
+    free(coproc->buffer);
+    coproc->buffer = NULL;
+    coproc->name[0] = '\0';
+}
+
+/*
+* Append an argument to the growable args array; the total size of the argument list is bounded by ARG_MAX
+*/
+int addArg(char *arg) {
+    // Size the argument takes in the exec argument list: the string, its NUL, and its pointer
+    long argLen = strlen(arg) + 1 + sizeof(char *);
+    // Refuse the argument if the list would be longer than the kernel accepts
+    if (inputs.argOverflow || inputs.argBytes + argLen > argMax) {
+        inputs.argOverflow = 1;
+        return -1;
+    }
+    // Double the args array when full, keeping room for the NULL terminator execvp() needs
+    if (inputs.argSize + 1 >= inputs.argCap) {
+        int newCap = inputs.argCap * 2;
+        char **newArgs = realloc(inputs.args, newCap * sizeof(inputs.args[0]));
+        if (newArgs == NULL) {
+            perror("realloc() error!");
+            exit(1);
+        }
+        inputs.args = newArgs;
+        inputs.argCap = newCap;
+    }
+    // Store the argument and keep the array NULL terminated
+    inputs.args[inputs.argSize] = arg;
+    inputs.argSize++;
+    inputs.args[inputs.argSize] = NULL;
+    inputs.argBytes += argLen;
+    return 0;
+}
+
+/*
+* Allocate memory that lives until the end of the current command line
+*/
+void *arenaAlloc(size_t size) {
+    // Round the size up so every allocation is pointer aligned
+    size = (size + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+    // Start a new block if the current one can't hold the allocation
+    if (lineArena == NULL || lineArena->used + size > lineArena->size) {
+        size_t blockSize = size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE;
+        struct arenaBlock *block = malloc(sizeof(struct arenaBlock) + blockSize);
+        if (block == NULL) {
+            perror("malloc() error!");
+            exit(1);
+        }
+        block->used = 0;
+        block->size = blockSize;
+        block->next = lineArena;
+        lineArena = block;
+    }
+    void *ptr = lineArena->data + lineArena->used;
+    lineArena->used += size;
+    return ptr;
+}
+
+/*
+* Free every arena block, along with the directory listings cached in them
+*/
+void arenaReset(void) {
+    while (lineArena != NULL) {
+        struct arenaBlock *next = lineArena->next;
+        free(lineArena);
+        lineArena = next;
+    }
+    // The cached listings lived in the arena, so the cache is now empty
+    dirCache = NULL;
+}
+
+/*
+* Remember how far the arena is filled, to give back everything allocated after this point
+*/
+void arenaMark(struct arenaMark *mark) {
+    mark->block = lineArena;
+    mark->used = lineArena != NULL ? lineArena->used : 0;
+    mark->cache = dirCache;
+}
+
+/*
+* Free everything allocated in the arena since the mark, including directory listings cached since then
+*/
+void arenaRelease(struct arenaMark *mark) {
+    while (lineArena != mark->block) {
+        struct arenaBlock *next = lineArena->next;
+        free(lineArena);
+        lineArena = next;
+    }
+    if (lineArena != NULL) {
+        lineArena->used = mark->used;
+    }
+    dirCache = mark->cache;
+}
+
+/*
+* Read a directory with getdents64, caching the listing for the rest of the command line
+*/
+struct dirListing *loadDirListing(char *path) {
+    // Reuse the listing if this directory was already read for the current command line
+    struct dirListing *listing;
+    for (listing = dirCache; listing != NULL; listing = listing->next) {
+        if (strcmp(listing->path, path) == 0) {
+            return listing;
+        }
+    }
+
+    int dirFD = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirFD == -1) {
+        return NULL;
+    }
+    char *buffer = malloc(DIRENT_BUFFER_SIZE);
+    if (buffer == NULL) {
+        perror("malloc() error!");
+        exit(1);
+    }
+
+    // Names and the names array are both kept in the arena
+    listing = arenaAlloc(sizeof(struct dirListing));
+    listing->path = arenaAlloc(strlen(path) + 1);
+    strcpy(listing->path, path);
+    listing->count = 0;
+    int namesCap = 256;
+    listing->names = arenaAlloc(namesCap * sizeof(char *));
+
+    // Read the directory in large batches to keep the number of system calls low
+    long numBytes;
+    while ((numBytes = syscall(SYS_getdents64, dirFD, buffer, DIRENT_BUFFER_SIZE)) > 0) {
+        long offset = 0;
+        while (offset < numBytes) {
+            struct linuxDirent64 *entry = (struct linuxDirent64 *) (buffer + offset);
+            offset += entry->d_reclen;
+            // Skip the "." and ".." entries
+            if (entry->d_name[0] == '.' && (entry->d_name[1] == '\0' || (entry->d_name[1] == '.' && entry->d_name[2] == '\0'))) {
+                continue;
+            }
+            // Double the names array when full; the old array is reclaimed with the arena
+            if (listing->count == namesCap) {
+                char **newNames = arenaAlloc(namesCap * 2 * sizeof(char *));
+                memcpy(newNames, listing->names, namesCap * sizeof(char *));
+                listing->names = newNames;
+                namesCap *= 2;
+            }
+            size_t nameLen = strlen(entry->d_name) + 1;
+            char *name = arenaAlloc(nameLen);
+            memcpy(name, entry->d_name, nameLen);
+            listing->names[listing->count] = name;
+            listing->count++;
+        }
+    }
+    free(buffer);
+    close(dirFD);
+
+    // Add the listing to the cache
+    listing->next = dirCache;
+    dirCache = listing;
+    return listing;
+}
+
+/*
+* Compare two names for qsort()
+*/
+int compareNames(const void *a, const void *b) {
+    return strcmp(*(char * const *) a, *(char * const *) b);
+}
+
+/*
+* Perform pathname expansion of "*", "?" and "[...]" in the last component of a token and store the sorted matches;
+* a token without matches is stored unchanged
+*/
+int expandGlob(char *token) {
+    // Tokens without wildcards are stored as they are
+    if (strpbrk(token, "*?[") == NULL) {
+        return addArg(token);
+    }
+
+    // Split the token into the directory to read and the pattern to match against its entries
+    char *dirPath = ".";
+    char *pattern = token;
+    size_t prefixLen = 0;
+    char *slash = strrchr(token, '/');
+    if (slash != NULL) {
+        prefixLen = slash - token + 1;
+        dirPath = arenaAlloc(prefixLen + 1);
+        memcpy(dirPath, token, prefixLen);
+        dirPath[prefixLen] = '\0';
+        pattern = slash + 1;
+        // Only the last component is expanded; wildcards in directory components are kept as they are
+        if (strpbrk(dirPath, "*?[") != NULL || strpbrk(pattern, "*?[") == NULL) {
+            return addArg(token);
+        }
+    }
+
+    struct dirListing *listing = loadDirListing(dirPath);
+    if (listing == NULL || listing->count == 0) {
+        return addArg(token);
+    }
+
+    // Collect the matching names, then sort them in one pass
+    char **matches = arenaAlloc(listing->count * sizeof(char *));
+    int matchCount = 0;
+    int i;
+    for (i = 0; i < listing->count; i++) {
+        // FNM_PERIOD keeps hidden files out unless the pattern starts with "."
+        if (fnmatch(pattern, listing->names[i], FNM_PERIOD) == 0) {
+            matches[matchCount] = listing->names[i];
+            matchCount++;
+        }
+    }
+    if (matchCount == 0) {
+        return addArg(token);
+    }
+    qsort(matches, matchCount, sizeof(char *), compareNames);
+
+    // Store the matches, adding back the directory prefix if there was one
+    for (i = 0; i < matchCount; i++) {
+        char *match = matches[i];
+        if (prefixLen > 0) {
+            size_t nameLen = strlen(matches[i]) + 1;
+            match = arenaAlloc(prefixLen + nameLen);
+            memcpy(match, token, prefixLen);
+            memcpy(match + prefixLen, matches[i], nameLen);
+        }
+        if (addArg(match) == -1) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/*
+* Print the prompt and read a line of input; a terminal gets the line editor, anything else is read with getline()
+*/
+int readInputLine(char *prompt, char **line, size_t *size) {
+    printf("%s", prompt);
+    fflush(stdout);
+    int numChars;
+    if (isatty(STDIN_FILENO)) {
+        numChars = editLine(prompt, line, size);
+    }
+    else {
+        // Keep deadlines firing while waiting for input, unless stdio already holds the next line
+        while (!stdinBuffered() && waitForInput() == -1) {
+            reapBackground();
+        }
+        numChars = getline(line, size, stdin);
+    }
+    // With --record, log the line and when it was entered
+    if (numChars > 0 && recordFile != NULL) {
+        recordLine(*line, numChars);
+    }
+    return numChars;
+}
+
+/*
+* Redraw the prompt and the line being edited, placing the cursor at pos
+*/
+void refreshLine(char *prompt, char *buf, int len, int pos) {
+    // Build the whole update in one buffer so it is written with a single write()
+    char *out = malloc(len + strlen(prompt) + 32);
+    int outLen = sprintf(out, "\r%s", prompt);
+    memcpy(out + outLen, buf, len);
+    outLen += len;
+    // Erase anything left over to the right, then move the cursor back into position
+    outLen += sprintf(out + outLen, "\x1b[K\r");
+    if (strlen(prompt) + pos > 0) {
+        outLen += sprintf(out + outLen, "\x1b[%dC", (int) strlen(prompt) + pos);
+    }
+    write(STDOUT_FILENO, out, outLen);
+    free(out);
+}
+
+/*
+* Read a line from the terminal in raw mode with cursor movement, deletion and tab completion;
+* returns the number of characters read including the newline, or -1 on end of input
+*/
+int editLine(char *prompt, char **line, size_t *size) {
+    // Start building the command index the first time an interactive line is read
+    startIndexRebuild();
+
+    // Switch the terminal to raw mode, keeping ISIG so SIGINT and SIGTSTP are still generated
+    struct termios cooked, raw;
+    if (tcgetattr(STDIN_FILENO, &cooked) == -1) {
+        return getline(line, size, stdin);
+    }
+    raw = cooked;
+    raw.c_lflag &= ~(ICANON | ECHO | IEXTEN);
+    raw.c_cc[VMIN] = 1;
+    raw.c_cc[VTIME] = 0;
+    tcsetattr(STDIN_FILENO, TCSAFLUSH, &raw);
+
+    int cap = 128, len = 0, pos = 0, result = -1;
+    char *buf = malloc(cap);
+    _Bool lastTab = 0;
+    while (1) {
+        char c;
+        // While deadlines are pending, the timerfd is watched along with the terminal
+        int numRead = waitForInput();
+        if (numRead == 0) {
+            numRead = read(STDIN_FILENO, &c, 1);
+        }
+        if (numRead == -1 && errno == EINTR) {
+            // A background process may have finished, freeing a slot for a queued job
+            reapBackground();
+            // A signal handler may have written to the terminal, so redraw the line
+            refreshLine(prompt, buf, len, pos);
+            continue;
+        }
+        if (numRead <= 0) {
+            break;
+        }
+        // Make sure there is room for one more character, the newline and the NUL
+        if (len + 3 > cap) {
+            cap *= 2;
+            buf = realloc(buf, cap);
+        }
+
+        if (c == '\r' || c == '\n') {
+            // Enter: finish the line
+            write(STDOUT_FILENO, "\n", 1);
+            buf[len] = '\n';
+            len++;
+            result = len;
+            break;
+        }
+        else if (c == '\t') {
+            // Tab: complete the word before the cursor, listing the candidates on a second tab
+            completeLine(prompt, &buf, &cap, &len, &pos, lastTab);
+            lastTab = 1;
+            continue;
+        }
+        else if (c == 4) {
+            // Ctrl-D: end of input on an empty line, else delete under the cursor
+            if (len == 0) {
+                write(STDOUT_FILENO, "\n", 1);
+                break;
+            }
+            if (pos < len) {
+                memmove(buf + pos, buf + pos + 1, len - pos - 1);
+                len--;
+            }
+        }
+        else if (c == 127 || c == 8) {
+            // Backspace: delete the character before the cursor
+            if (pos > 0) {
+                memmove(buf + pos - 1, buf + pos, len - pos);
+                pos--;
+                len--;
+            }
+        }
+        else if (c == 1) {
+            // Ctrl-A: move to the start of the line
+            pos = 0;
+        }
+        else if (c == 5) {
+            // Ctrl-E: move to the end of the line
+            pos = len;
+        }
+        else if (c == 21) {
+            // Ctrl-U: delete from the start of the line to the cursor
+            memmove(buf, buf + pos, len - pos);
+            len -= pos;
+            pos = 0;
+        }
+        else if (c == 11) {
+            // Ctrl-K: delete from the cursor to the end of the line
+            len = pos;
+        }
+        else if (c == 23) {
+            // Ctrl-W: delete the word before the cursor
+            int start = pos;
+            while (start > 0 && buf[start - 1] == ' ') start--;
+            while (start > 0 && buf[start - 1] != ' ') start--;
+            memmove(buf + start, buf + pos, len - pos);
+            len -= pos - start;
+            pos = start;
+        }
+        else if (c == 27) {
+            // Escape sequences for the arrow, Home, End and Delete keys
+            char seq[3];
+            if (read(STDIN_FILENO, &seq[0], 1) != 1 || read(STDIN_FILENO, &seq[1], 1) != 1) {
+                continue;
+            }
+            if (seq[0] == '[' && seq[1] >= '0' && seq[1] <= '9') {
+                if (read(STDIN_FILENO, &seq[2], 1) != 1) {
+                    continue;
+                }
+                if (seq[2] == '~' && seq[1] == '3' && pos < len) {
+                    memmove(buf + pos, buf + pos + 1, len - pos - 1);
+                    len--;
+                }
+                else if (seq[2] == '~' && (seq[1] == '1' || seq[1] == '7')) {
+                    pos = 0;
+                }
+                else if (seq[2] == '~' && (seq[1] == '4' || seq[1] == '8')) {
+                    pos = len;
+                }
+            }
+            else if (seq[0] == '[' || seq[0] == 'O') {
+                if (seq[1] == 'C' && pos < len) pos++;
+                else if (seq[1] == 'D' && pos > 0) pos--;
+                else if (seq[1] == 'H') pos = 0;
+                else if (seq[1] == 'F') pos = len;
+            }
+        }
+        else if ((unsigned char) c >= 32) {
+            // Printable character: insert it at the cursor
+            memmove(buf + pos + 1, buf + pos, len - pos);
+            buf[pos] = c;
+            pos++;
+            len++;
+        }
+        lastTab = 0;
+        refreshLine(prompt, buf, len, pos);
+    }
+
+    // Restore the terminal before any command runs
+    tcsetattr(STDIN_FILENO, TCSAFLUSH, &cooked);
+
+    // Hand the line back the same way getline() would
+    buf[len] = '\0';
+    free(*line);
+    *line = buf;
+    *size = cap;
+    return result;
+}
+
+/*
+* Complete the word before the cursor as a command or a path; on a repeated tab with several candidates, list them
+*/
+void completeLine(char *prompt, char **bufPtr, int *cap, int *len, int *pos, _Bool listAll) {
+    char *buf = *bufPtr;
+    // Find the start of the word before the cursor
+    int start = *pos;
+    while (start > 0 && buf[start - 1] != ' ') start--;
+    // The word is a command if only spaces come before it and it has no "/"
+    int i;
+    _Bool isCommand = 1;
+    for (i = 0; i < start; i++) {
+        if (buf[i] != ' ') {
+            isCommand = 0;
+        }
+    }
+    char *word = strndup(buf + start, *pos - start);
+    if (strchr(word, '/') != NULL) {
+        isCommand = 0;
+    }
+
+    // Gather the candidates that extend the word
+    struct completion matches = {0};
+    int prefixLen;
+    if (isCommand) {
+        prefixLen = strlen(word);
+        completeCommand(word, &matches);
+    }
+    else {
+        char *slash = strrchr(word, '/');
+        prefixLen = slash == NULL ? strlen(word) : strlen(slash + 1);
+        completePath(word, &matches);
+    }
+
+    if (matches.count > 0) {
+        // Find the longest common prefix of the candidates
+        int common = strlen(matches.names[0]);
+        for (i = 1; i < matches.count; i++) {
+            int j = 0;
+            while (j < common && matches.names[i][j] == matches.names[0][j]) j++;
+            common = j;
+        }
+        // Insert what the candidates have in common past the word, plus a space after a finished command or file
+        int addLen = common - prefixLen;
+        _Bool finished = matches.count == 1 && matches.names[0][common - 1] != '/';
+        if (addLen > 0 || finished) {
+            while (*len + addLen + 4 > *cap) {
+                *cap *= 2;
+                buf = realloc(buf, *cap);
+            }
+            memmove(buf + *pos + addLen + finished, buf + *pos, *len - *pos);
+            memcpy(buf + *pos, matches.names[0] + prefixLen, addLen);
+            if (finished) {
+                buf[*pos + addLen] = ' ';
+            }
+            *pos += addLen + finished;
+            *len += addLen + finished;
+        }
+        else if (listAll && matches.count > 1) {
+            // Nothing to add, so show the candidates below the line
+            write(STDOUT_FILENO, "\n", 1);
+            for (i = 0; i < matches.count; i++) {
+                write(STDOUT_FILENO, matches.names[i], strlen(matches.names[i]));
+                write(STDOUT_FILENO, i + 1 < matches.count ? "  " : "\n", i + 1 < matches.count ? 2 : 1);
+            }
+        }
+    }
+
+    for (i = 0; i < matches.count; i++) {
+        free(matches.names[i]);
+    }
+    free(matches.names);
+    free(word);
+    *bufPtr = buf;
+    refreshLine(prompt, buf, *len, *pos);
+}
+
+/*
+* Add a candidate to a list of completions
+*/
+void addCompletion(struct completion *matches, char *name) {
+    if (matches->count == matches->cap) {
+        matches->cap = matches->cap ? matches->cap * 2 : 16;
+        matches->names = realloc(matches->names, matches->cap * sizeof(char *));
+    }
+    matches->names[matches->count] = name;
+    matches->count++;
+}
+
+/*
+* Complete a command name from the built-in commands and the index of executables on PATH
+*/
+void completeCommand(char *prefix, struct completion *matches) {
+    // Built-in commands are always available
+    char *builtins[] = {".", "cd", "coproc", "coproc-close", "coproc-read", "coproc-send", "exit", "jobs", "set", "source", "status", "timeout"};
+    int i;
+    for (i = 0; i < (int) (sizeof(builtins) / sizeof(builtins[0])); i++) {
+        if (strncmp(builtins[i], prefix, strlen(prefix)) == 0) {
+            addCompletion(matches, strdup(builtins[i]));
+        }
+    }
+
+    // Pick up an index finished in the background and check whether PATH needs another look
+    installPendingIndex();
+    startIndexRebuild();
+    if (commandIndex == NULL) {
+        return;
+    }
+
+    // Walk down the trie along the prefix
+    struct trieNode *nodes = commandIndex->nodes;
+    int node = 0, depth;
+    for (depth = 0; prefix[depth] != '\0'; depth++) {
+        int child = nodes[node].child;
+        while (child != -1 && nodes[child].ch != prefix[depth]) {
+            child = nodes[child].sibling;
+        }
+        if (child == -1) {
+            return;
+        }
+        node = child;
+    }
+    // Collect every name below the node
+    char name[NAME_MAX + 1];
+    strcpy(name, prefix);
+    collectTrie(nodes, node, name, depth, matches);
+}
+
+/*
+* Collect the names stored below a trie node, in sorted order
+*/
+void collectTrie(struct trieNode *nodes, int node, char *name, int depth, struct completion *matches) {
+    if (nodes[node].terminal) {
+        name[depth] = '\0';
+        addCompletion(matches, strdup(name));
+    }
+    if (depth >= NAME_MAX) {
+        return;
+    }
+    int child;
+    for (child = nodes[node].child; child != -1; child = nodes[child].sibling) {
+        name[depth] = nodes[child].ch;
+        collectTrie(nodes, child, name, depth + 1, matches);
+    }
+}
+
+/*
+* Complete a path from the entries of its directory; directories get a trailing "/"
+*/
+void completePath(char *word, struct completion *matches) {
+    // Split the word into the directory to read and the prefix of the entry
+    char *slash = strrchr(word, '/');
+    char *dirPath = ".";
+    char *prefix = word;
+    if (slash != NULL) {
+        dirPath = strndup(word, slash - word + 1);
+        prefix = slash + 1;
+    }
+
+    DIR *dir = opendir(dirPath);
+    if (dir != NULL) {
+        struct dirent *entry;
+        size_t prefixLen = strlen(prefix);
+        while ((entry = readdir(dir)) != NULL) {
+            // Hidden entries only complete when asked for, and "." and ".." never do
+            if ((entry->d_name[0] == '.' && prefix[0] != '.') || strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+                continue;
+            }
+            if (strncmp(entry->d_name, prefix, prefixLen) != 0) {
+                continue;
+            }
+            // Mark directories with a trailing "/"
+            _Bool isDir = entry->d_type == DT_DIR;
+            if (entry->d_type == DT_UNKNOWN || entry->d_type == DT_LNK) {
+                struct stat st;
+                isDir = fstatat(dirfd(dir), entry->d_name, &st, 0) == 0 && S_ISDIR(st.st_mode);
+            }
+            char *name = malloc(strlen(entry->d_name) + 2);
+            sprintf(name, "%s%s", entry->d_name, isDir ? "/" : "");
+            addCompletion(matches, name);
+        }
+        closedir(dir);
+    }
+    if (slash != NULL) {
+        free(dirPath);
+    }
+    qsort(matches->names, matches->count, sizeof(char *), compareNames);
+}
+
+/*
+* Start a background rebuild of the command index, unless one is running or PATH was checked within the last second
+*/
+void startIndexRebuild(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (__atomic_load_n(&indexRebuilding, __ATOMIC_ACQUIRE) || now.tv_sec - lastIndexCheck < INDEX_CHECK_INTERVAL) {
+        return;
+    }
+    lastIndexCheck = now.tv_sec;
+    // Install what the last rebuild finished first, so the thread compares against the index in use and has no
+    // finished index to overwrite
+    installPendingIndex();
+
+    // The thread compares PATH against the current index; the index is only replaced after the thread is done with it
+    struct indexRequest *request = malloc(sizeof(struct indexRequest));
+    char *path = getenv("PATH");
+    request->path = strdup(path != NULL ? path : "");
+    request->old = commandIndex;
+    __atomic_store_n(&indexRebuilding, 1, __ATOMIC_RELEASE);
+
+    // Run the thread detached with all signals blocked, so the main thread keeps handling them
+    pthread_t thread;
+    pthread_attr_t attr;
+    sigset_t allSignals, oldMask;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    sigfillset(&allSignals);
+    pthread_sigmask(SIG_SETMASK, &allSignals, &oldMask);
+    if (pthread_create(&thread, &attr, rebuildIndex, request) != 0) {
+        __atomic_store_n(&indexRebuilding, 0, __ATOMIC_RELEASE);
+        free(request->path);
+        free(request);
+    }
+    pthread_sigmask(SIG_SETMASK, &oldMask, NULL);
+    pthread_attr_destroy(&attr);
+}
+
+/*
+* Swap in a command index that was finished in the background. While a rebuild runs, its thread reads the current
+* index, so it is only freed once no thread is running
+*/
+void installPendingIndex(void) {
+    if (__atomic_load_n(&indexRebuilding, __ATOMIC_ACQUIRE)) {
+        return;
+    }
+    struct cmdIndex *pending = __atomic_exchange_n(&pendingIndex, NULL, __ATOMIC_ACQ_REL);
+    if (pending != NULL) {
+        freeIndex(commandIndex);
+        commandIndex = pending;
+    }
+}
+
+/*
+* Thread body: stat every PATH directory, and only if one was added, removed or changed its mtime, publish a new index.
+* Changed directories are read again; the names of unchanged ones are moved over from the old index, which the main
+* thread only uses for its trie
+*/
+void *rebuildIndex(void *arg) {
+    struct indexRequest *request = arg;
+    struct cmdIndex *old = request->old;
+    _Bool changed = old == NULL;
+
+    // Compare PATH with the old index without allocating, as nothing has changed on most checks
+    int dirCount = 0;
+    char *dirPath = request->path;
+    while (*dirPath != '\0') {
+        size_t len = strcspn(dirPath, ":");
+        char separator = dirPath[len];
+        if (len > 0) {
+            // End the directory's path where the next one starts, for stat(), then put the separator back
+            struct stat st;
+            memset(&st, 0, sizeof(st));
+            dirPath[len] = '\0';
+            stat(dirPath, &st);
+            dirPath[len] = separator;
+            if (!changed && (dirCount >= old->dirCount || strncmp(old->dirs[dirCount].path, dirPath, len) != 0 || old->dirs[dirCount].path[len] != '\0'
+                             || old->dirs[dirCount].mtime.tv_sec != st.st_mtim.tv_sec || old->dirs[dirCount].mtime.tv_nsec != st.st_mtim.tv_nsec)) {
+                changed = 1;
+            }
+            dirCount++;
+        }
+        dirPath += len + (separator == ':');
+    }
+    if (!changed && dirCount == old->dirCount) {
+        free(request->path);
+        free(request);
+        __atomic_store_n(&indexRebuilding, 0, __ATOMIC_RELEASE);
+        return NULL;
+    }
+
+    struct cmdIndex *index = calloc(1, sizeof(struct cmdIndex));
+    index->dirs = calloc(dirCount + 1, sizeof(struct pathDir));
+    char *saveptr;
+    dirPath = strtok_r(request->path, ":", &saveptr);
+    while (dirPath != NULL) {
+        struct pathDir *dir = &index->dirs[index->dirCount];
+        index->dirCount++;
+        dir->path = strdup(dirPath);
+        struct stat st;
+        if (stat(dirPath, &st) == 0) {
+            dir->mtime = st.st_mtim;
+        }
+
+        // Find the same directory in the old index
+        struct pathDir *oldDir = NULL;
+        if (old != NULL && index->dirCount <= old->dirCount && strcmp(old->dirs[index->dirCount - 1].path, dirPath) == 0) {
+            oldDir = &old->dirs[index->dirCount - 1];
+        }
+
+        if (oldDir != NULL && oldDir->names != NULL && oldDir->mtime.tv_sec == dir->mtime.tv_sec && oldDir->mtime.tv_nsec == dir->mtime.tv_nsec) {
+            // Unchanged since the last look: take its names over instead of reading the directory again
+            dir->names = oldDir->names;
+            dir->count = oldDir->count;
+            oldDir->names = NULL;
+            oldDir->count = 0;
+        }
+        else {
+            // New or changed: list the executables in it
+            readPathDir(dir);
+        }
+        dirPath = strtok_r(NULL, ":", &saveptr);
+    }
+
+    // Build the trie from every directory and hand it to the main thread
+    buildTrie(index);
+    __atomic_store_n(&pendingIndex, index, __ATOMIC_RELEASE);
+    free(request->path);
+    free(request);
+    __atomic_store_n(&indexRebuilding, 0, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+/*
+* List the executable files in a PATH directory
+*/
+void readPathDir(struct pathDir *dir) {
+    int cap = 64;
+    dir->names = malloc(cap * sizeof(char *));
+    dir->count = 0;
+    DIR *dirStream = opendir(dir->path);
+    if (dirStream == NULL) {
+        return;
+    }
+    struct dirent *entry;
+    while ((entry = readdir(dirStream)) != NULL) {
+        if (entry->d_name[0] == '.' || entry->d_type == DT_DIR) {
+            continue;
+        }
+        if (faccessat(dirfd(dirStream), entry->d_name, X_OK, 0) != 0) {
+            continue;
+        }
+        if (dir->count == cap) {
+            cap *= 2;
+            dir->names = realloc(dir->names, cap * sizeof(char *));
+        }
+        dir->names[dir->count] = strdup(entry->d_name);
+        dir->count++;
+    }
+    closedir(dirStream);
+}
+
+/*
+* Insert every executable name of the index into its trie; children are kept sorted so listings come out in order
+*/
+void buildTrie(struct cmdIndex *index) {
+    index->nodeCap = 1024;
+    index->nodes = malloc(index->nodeCap * sizeof(struct trieNode));
+    // Node 0 is the root
+    index->nodes[0] = (struct trieNode) {0, 0, -1, -1};
+    index->nodeCount = 1;
+
+    int d, i;
+    for (d = 0; d < index->dirCount; d++) {
+        for (i = 0; i < index->dirs[d].count; i++) {
+            char *name = index->dirs[d].names[i];
+            int node = 0;
+            for (; *name != '\0'; name++) {
+                // Find the child for this character, or the sibling to insert it after
+                int prev = -1;
+                int child = index->nodes[node].child;
+                while (child != -1 && index->nodes[child].ch < *name) {
+                    prev = child;
+                    child = index->nodes[child].sibling;
+                }
+                if (child == -1 || index->nodes[child].ch != *name) {
+                    // Nodes link by index, so growing the array keeps the links valid
+                    if (index->nodeCount == index->nodeCap) {
+                        index->nodeCap *= 2;
+                        index->nodes = realloc(index->nodes, index->nodeCap * sizeof(struct trieNode));
+                    }
+                    int newNode = index->nodeCount;
+                    index->nodeCount++;
+                    index->nodes[newNode] = (struct trieNode) {*name, 0, -1, child};
+                    if (prev == -1) {
+                        index->nodes[node].child = newNode;
+                    }
+                    else {
+                        index->nodes[prev].sibling = newNode;
+                    }
+                    child = newNode;
+                }
+                node = child;
+            }
+            index->nodes[node].terminal = 1;
+        }
+    }
+}
+
+/*
+* Free a command index
+*/
+void freeIndex(struct cmdIndex *index) {
+    if (index == NULL) {
+        return;
+    }
+    int d, i;
+    for (d = 0; d < index->dirCount; d++) {
+        for (i = 0; i < index->dirs[d].count; i++) {
+            free(index->dirs[d].names[i]);
+        }
+        free(index->dirs[d].names);
+        free(index->dirs[d].path);
+    }
+    free(index->dirs);
+    free(index->nodes);
+    free(index);
+}
+
+/*
+* Run a script file in script mode: no prompts, one command list per line
+*/
+int runScriptFile(char *path) {
+    struct script script = {0};
+    if (loadScript(path, &script) == -1) {
+        perror(path);
+        inputs.signalTerm = 0;
+        inputs.exitStatus = 1;
+        return -1;
+    }
+    runScript(&script);
+    freeScript(&script);
+    return 0;
+}
+
+/*
+* Run the lines of a loaded script until the end or the exit built-in; returns the status of the last line run
+*/
+int runScript(struct script *script) {
+    // Each line gives back what it allocated in the arena, leaving anything the caller has there in place
+    struct arenaMark mark;
+    arenaMark(&mark);
+    int i, status = 0;
+    for (i = 0; i < script->lineCount && !inputs.exitShell; i++) {
+        // Report background processes that finished and launch queued jobs in their place
+        reapBackground();
+        if (script->lines[i] == -2) {
+            // Syntax error, reported when the script was parsed: nothing is run
+            inputs.signalTerm = 0;
+            inputs.exitStatus = 1;
+            status = 1;
+        }
+        else {
+            status = runNode(script, script->lines[i]);
+        }
+        // Free expanded variables, glob matches and cached directory listings of this line
+        arenaRelease(&mark);
+    }
+    return status;
+}
+
+/*
+* Built-in source: "source FILE" or ". FILE" runs the lines of FILE in this shell process, so directory changes,
+* variables and settings carry over; returns the status of the last line run
+*/
+int sourceBuiltin(void) {
+    if (inputs.argSize < 2) {
+        printf("smallsh: source: usage: source FILE\n");
+        fflush(stdout);
+        return 2;
+    }
+    // A file that sources itself stops at the depth limit instead of overflowing the stack
+    if (sourceDepth >= SOURCE_DEPTH_LIMIT) {
+        printf("smallsh: source: %s: nested too deeply\n", inputs.args[1]);
+        fflush(stdout);
+        return 1;
+    }
+    // The file is read whole, or mapped from the compiled script cache, like a script run from the command line
+    struct script script = {0};
+    if (loadScript(inputs.args[1], &script) == -1) {
+        perror(inputs.args[1]);
+        inputs.signalTerm = 0;
+        inputs.exitStatus = 1;
+        return 1;
+    }
+    sourceDepth++;
+    int status = runScript(&script);
+    sourceDepth--;
+    freeScript(&script);
+    return status;
+}
+
+/*
+* Load a script, from its compiled cache if that is current, else by parsing it and refreshing the cache
+*/
+int loadScript(char *path, struct script *script) {
+    int scriptFD = open(path, O_RDONLY | O_CLOEXEC);
+    if (scriptFD == -1) {
+        return -1;
+    }
+    struct stat scriptStat;
+    fstat(scriptFD, &scriptStat);
+
+    // The cache is found by the script's absolute path and checked against its size, mtime and inode; only regular
+    // files have those, so a FIFO or /dev/stdin is always parsed
+    char absPath[PATH_MAX], cachePath[PATH_MAX];
+    _Bool haveCache = S_ISREG(scriptStat.st_mode) && realpath(path, absPath) != NULL && scriptCachePath(absPath, cachePath) == 0;
+    if (haveCache && mapScriptCache(cachePath, &scriptStat, absPath, script) == 0) {
+        close(scriptFD);
+        return 0;
+    }
+
+    // Read up to end of file: the size is only a first guess, as a FIFO or /dev/stdin reports 0 and a file can grow
+    size_t textCap = scriptStat.st_size > 0 ? (size_t) scriptStat.st_size + 1 : 4096;
+    char *text = malloc(textCap);
+    size_t textLen = 0;
+    ssize_t numRead;
+    while ((numRead = read(scriptFD, text + textLen, textCap - 1 - textLen)) != 0) {
+        if (numRead == -1 && errno == EINTR) {
+            continue;
+        }
+        if (numRead == -1) {
+            break;
+        }
+        textLen += numRead;
+        if (textLen == textCap - 1) {
+            textCap *= 2;
+            text = realloc(text, textCap);
+        }
+    }
+    text[textLen] = '\0';
+
+    // Only scripts that parse cleanly are cached, so syntax errors are reported on every run; a file that changed
+    // while it was read is not, as the cache would not match what was parsed
+    int errors = compileScript(text, script);
+    free(text);
+    struct stat readStat;
+    if (fstat(scriptFD, &readStat) == -1 || (size_t) readStat.st_size != textLen || readStat.st_size != scriptStat.st_size
+        || readStat.st_mtim.tv_sec != scriptStat.st_mtim.tv_sec || readStat.st_mtim.tv_nsec != scriptStat.st_mtim.tv_nsec) {
+        haveCache = 0;
+    }
+    close(scriptFD);
+    if (haveCache && errors == 0) {
+        writeScriptCache(cachePath, &scriptStat, absPath, script);
+    }
+    return 0;
+}
+
+/*
+* Line source for the prompt: a continuation line read from the user; the lines are kept until the command is parsed
+*/
+char *nextInputLine(struct lineSource *source) {
+    while (1) {
+        char *line = NULL;
+        size_t bufferSize = 0;
+        int numChars = readInputLine("> ", &line, &bufferSize);
+        if (numChars == -1) {
+            clearerr(stdin);
+            free(line);
+            return NULL;
+        }
+        // Keep the line, since tokens point into it until parsing is done
+        if (source->lineCount == source->lineCap) {
+            source->lineCap = source->lineCap ? source->lineCap * 2 : 4;
+            source->lines = realloc(source->lines, source->lineCap * sizeof(char *));
+        }
+        source->lines[source->lineCount] = line;
+        source->lineCount++;
+        // A here-document line is kept as it is, apart from the newline
+        if (source->raw) {
+            if (numChars > 0 && line[numChars - 1] == '\n') {
+                line[numChars - 1] = '\0';
+            }
+            return line;
+        }
+        // Remove the newline and any extra whitespace at the end of the line
+        int i = numChars - 1;
+        while (i >= 0 && (line[i] == '\n' || line[i] == ' ')) {
+            line[i] = '\0';
+            i--;
+        }
+        if (line[0] != '\0' && line[0] != '#') {
+            return line;
+        }
+    }
+}
+
+/*
+* Free the continuation lines read by a line source
+*/
+void freeInputLines(struct lineSource *source) {
+    int i;
+    for (i = 0; i < source->lineCount; i++) {
+        free(source->lines[i]);
+    }
+    free(source->lines);
+    source->lines = NULL;
+    source->lineCount = source->lineCap = 0;
+}
+
+/*
+* FNV-1a hash, used for cache file names and cache checksums
+*/
+uint64_t hashBytes(const void *data, size_t len, uint64_t hash) {
+    const unsigned char *bytes = data;
+    size_t i;
+    for (i = 0; i < len; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+/*
+* Build the cache file path for a script, creating the cache directory if needed
+*/
+int scriptCachePath(char *absPath, char *cachePath) {
+    // Use $XDG_CACHE_HOME/smallsh, else $HOME/.cache/smallsh
+    char dirPath[PATH_MAX];
+    char *cacheHome = getenv("XDG_CACHE_HOME");
+    char *home = getenv("HOME");
+    if (cacheHome != NULL && cacheHome[0] != '\0') {
+        snprintf(dirPath, PATH_MAX, "%s", cacheHome);
+    }
+    else if (home != NULL && home[0] != '\0') {
+        snprintf(dirPath, PATH_MAX, "%s/.cache", home);
+    }
+    else {
+        return -1;
+    }
+    mkdir(dirPath, 0700);
+    strncat(dirPath, "/smallsh", PATH_MAX - strlen(dirPath) - 1);
+    if (mkdir(dirPath, 0700) == -1 && errno != EEXIST) {
+        return -1;
+    }
+    uint64_t key = hashBytes(absPath, strlen(absPath), CACHE_HASH_SEED);
+    if (snprintf(cachePath, PATH_MAX, "%s/%016llx.smc", dirPath, (unsigned long long) key) >= PATH_MAX) {
+        return -1;
+    }
+    return 0;
+}
+
+/*
+* Map a compiled script from the cache; fails if the cache is missing, stale, corrupt or from a different build
+*/
+int mapScriptCache(char *cachePath, struct stat *scriptStat, char *absPath, struct script *script) {
+    int cacheFD = open(cachePath, O_RDONLY | O_CLOEXEC);
+    if (cacheFD == -1) {
+        return -1;
+    }
+    struct stat cacheStat;
+    if (fstat(cacheFD, &cacheStat) == -1 || cacheStat.st_size < (off_t) sizeof(struct cacheHeader)) {
+        close(cacheFD);
+        return -1;
+    }
+    char *map = mmap(NULL, cacheStat.st_size, PROT_READ, MAP_PRIVATE, cacheFD, 0);
+    close(cacheFD);
+    if (map == MAP_FAILED) {
+        return -1;
+    }
+
+    // Check the header against this build and the script as it is now
+    struct cacheHeader *header = (struct cacheHeader *) map;
+    size_t pathLen = strlen(absPath);
+    size_t expected = sizeof(struct cacheHeader) + (size_t) header->nodeCount * sizeof(struct astNode) + (size_t) header->wordCount * sizeof(struct astWord)
+                      + (size_t) header->lineCount * sizeof(int) + header->stringLen + header->pathLen;
+    if (memcmp(header->magic, CACHE_MAGIC, sizeof(header->magic)) != 0 || header->version != CACHE_VERSION
+        || header->nodeSize != sizeof(struct astNode) || header->wordSize != sizeof(struct astWord)
+        || header->nodeCount > INT_MAX || header->wordCount > INT_MAX || header->lineCount > INT_MAX || header->stringLen > INT_MAX
+        || expected != (size_t) cacheStat.st_size
+        || header->scriptSize != (uint64_t) scriptStat->st_size || header->inode != (uint64_t) scriptStat->st_ino || header->device != (uint64_t) scriptStat->st_dev
+        || header->mtimeSec != (int64_t) scriptStat->st_mtim.tv_sec || header->mtimeNsec != (int64_t) scriptStat->st_mtim.tv_nsec
+        || header->pathLen != pathLen
+        || hashBytes(map + sizeof(struct cacheHeader), cacheStat.st_size - sizeof(struct cacheHeader), CACHE_HASH_SEED) != header->checksum) {
+        munmap(map, cacheStat.st_size);
+        return -1;
+    }
+
+    // Point the script at the sections of the mapping; offsets and indices need no fixing up
+    char *section = map + sizeof(struct cacheHeader);
+    script->nodes = (struct astNode *) section;
+    script->nodeCount = header->nodeCount;
+    section += header->nodeCount * sizeof(struct astNode);
+    script->words = (struct astWord *) section;
+    script->wordCount = header->wordCount;
+    section += header->wordCount * sizeof(struct astWord);
+    script->lines = (int *) section;
+    script->lineCount = header->lineCount;
+    section += header->lineCount * sizeof(int);
+    script->strings = section;
+    script->stringLen = header->stringLen;
+    section += header->stringLen;
+    script->map = map;
+    script->mapSize = cacheStat.st_size;
+
+    // The cache must be for this path, and every index in it must be in range
+    if (memcmp(section, absPath, pathLen) != 0 || validateScript(script) == -1) {
+        freeScript(script);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+* Check that every node, word and string reference in a script is in range, and that no command has more ">+" files
+* than a fanout holds; children must come before their parents, so a corrupt cache can't make runNode() loop
+*/
+int validateScript(struct script *script) {
+    int i;
+    if (script->stringLen > 0 && script->strings[script->stringLen - 1] != '\0') {
+        return -1;
+    }
+    for (i = 0; i < script->wordCount; i++) {
+        if (script->words[i].str < 0 || script->words[i].str >= script->stringLen) {
+            return -1;
+        }
+    }
+    for (i = 0; i < script->nodeCount; i++) {
+        struct astNode *node = &script->nodes[i];
+        if (node->type < NODE_SIMPLE || node->type > NODE_LAST || node->left < -1 || node->left >= i || node->right < -1 || node->right >= i
+            || node->wordStart < 0 || node->wordStart > script->wordCount || node->wordCount < 0 || node->wordCount > script->wordCount - node->wordStart
+            || node->inputFile < -1 || node->inputFile >= script->wordCount || node->outputFile < -1 || node->outputFile >= script->wordCount
+            || node->teeStart < 0 || node->teeStart > script->wordCount || node->teeCount < 0 || node->teeCount > TEE_LIMIT
+            || node->teeCount > script->wordCount - node->teeStart
+            || node->var < -1 || node->var >= script->wordCount) {
+            return -1;
+        }
+        if (node->type == NODE_FOR ? node->left == -1 || node->var == -1 : node->type != NODE_SIMPLE && (node->left == -1 || node->right == -1)) {
+            return -1;
+        }
+    }
+    for (i = 0; i < script->lineCount; i++) {
+        if (script->lines[i] < 0 || script->lines[i] >= script->nodeCount) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/*
+* Write a compiled script to the cache; the file is written under a temporary name and renamed into place
+*/
+void writeScriptCache(char *cachePath, struct stat *scriptStat, char *absPath, struct script *script) {
+    struct cacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CACHE_MAGIC, sizeof(header.magic));
+    header.version = CACHE_VERSION;
+    header.nodeSize = sizeof(struct astNode);
+    header.wordSize = sizeof(struct astWord);
+    header.scriptSize = scriptStat->st_size;
+    header.inode = scriptStat->st_ino;
+    header.device = scriptStat->st_dev;
+    header.mtimeSec = scriptStat->st_mtim.tv_sec;
+    header.mtimeNsec = scriptStat->st_mtim.tv_nsec;
+    header.nodeCount = script->nodeCount;
+    header.wordCount = script->wordCount;
+    header.lineCount = script->lineCount;
+    header.stringLen = script->stringLen;
+    header.pathLen = strlen(absPath);
+
+    // Sections follow the header in this order
+    struct iovec sections[6] = {
+        {&header, sizeof(header)},
+        {script->nodes, script->nodeCount * sizeof(struct astNode)},
+        {script->words, script->wordCount * sizeof(struct astWord)},
+        {script->lines, script->lineCount * sizeof(int)},
+        {script->strings, script->stringLen},
+        {absPath, header.pathLen}
+    };
+    uint64_t checksum = CACHE_HASH_SEED;
+    int i;
+    for (i = 1; i < 6; i++) {
+        checksum = hashBytes(sections[i].iov_base, sections[i].iov_len, checksum);
+    }
+    header.checksum = checksum;
+
+    char tempPath[PATH_MAX + 16];
+    snprintf(tempPath, sizeof(tempPath), "%s.%d", cachePath, getpid());
+    int cacheFD = open(tempPath, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (cacheFD == -1) {
+        return;
+    }
+    size_t total = 0;
+    for (i = 0; i < 6; i++) {
+        total += sections[i].iov_len;
+    }
+    if (writev(cacheFD, sections, 6) != (ssize_t) total) {
+        close(cacheFD);
+        unlink(tempPath);
+        return;
+    }
+    close(cacheFD);
+    rename(tempPath, cachePath);
+}
+
+/*
+* Append a line read from the user to the --record file, after the time it was entered
+*/
+void recordLine(char *line, int len) {
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    if (line[len - 1] == '\n') {
+        len--;
+    }
+    fprintf(recordFile, "%lld.%09ld\t%.*s\n", (long long) now.tv_sec, now.tv_nsec, len, line);
+    fflush(recordFile);
+}
+
+/*
+* Load a session written by --record: lines of "SECONDS.NANOSECONDS", a tab and the line entered
+*/
+int loadRecording(char *path) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        perror(path);
+        return -1;
+    }
+    char *line = NULL;
+    size_t size = 0;
+    ssize_t numChars;
+    int lineNumber = 0;
+    while ((numChars = getline(&line, &size, file)) != -1) {
+        lineNumber++;
+        if (numChars > 0 && line[numChars - 1] == '\n') {
+            line[numChars - 1] = '\0';
+        }
+        char *tab = strchr(line, '\t');
+        long long seconds;
+        long nanoseconds;
+        int used = 0;
+        if (tab == NULL || sscanf(line, "%lld.%9ld%n", &seconds, &nanoseconds, &used) != 2 || line + used != tab) {
+            fprintf(stderr, "smallsh: %s:%d: not a session record\n", path, lineNumber);
+            free(line);
+            fclose(file);
+            return -1;
+        }
+        if (replayCount == replayCap) {
+            replayCap = replayCap ? replayCap * 2 : 64;
+            replayLines = realloc(replayLines, replayCap * sizeof(struct replayLine));
+        }
+        replayLines[replayCount].time = seconds * 1000000000LL + nanoseconds;
+        replayLines[replayCount].text = strdup(tab + 1);
+        replayCount++;
+    }
+    free(line);
+    fclose(file);
+    return 0;
+}
+
+/*
+* Line source for a replayed session: the recorded lines that continue a command, such as a loop body or here-document
+*/
+char *nextReplayLine(struct lineSource *source) {
+    while (replayNext < replayCount) {
+        char *line = replayLines[replayNext].text;
+        replayNext++;
+        if (source->raw || (line[0] != '\0' && line[0] != '#')) {
+            return line;
+        }
+    }
+    return NULL;
+}
+
+/*
+* Replay a recorded session as a load test: each of concurrency copies of the shell runs every line, at the recorded
+* pace scaled by rate, or back to back when rate is 0. Reports throughput and latency percentiles per command type
+*/
+int replaySession(char *path, double rate, int concurrency) {
+    if (loadRecording(path) == -1) {
+        return 1;
+    }
+    if (replayCount == 0) {
+        fprintf(stderr, "smallsh: %s: no lines to replay\n", path);
+        return 1;
+    }
+    // The copies send a sample per command; samples are smaller than PIPE_BUF, so writes from several don't mix
+    int resultFDs[2];
+    if (pipe2(resultFDs, O_CLOEXEC) == -1) {
+        perror("pipe2() error!");
+        return 1;
+    }
+    // Ctrl-C stops the replay, copies and commands alike
+    sigaction(SIGINT, &defaultAction, NULL);
+    fflush(stdout);
+    long long start = monotonicNow();
+    pid_t *workers = malloc(concurrency * sizeof(pid_t));
+    int started = 0, i;
+    for (i = 0; i < concurrency; i++) {
+        pid_t pid = fork();
+        if (pid == -1) {
+            perror("fork() error!");
+            break;
+        }
+        if (pid == 0) {
+            close(resultFDs[0]);
+            replayWorker(rate, start, resultFDs[1]);
+        }
+        workers[started] = pid;
+        started++;
+    }
+    close(resultFDs[1]);
+
+    // Gather samples until every copy has finished and closed its end of the pipe
+    int count = 0, cap = 1024;
+    struct replaySample *samples = malloc(cap * sizeof(struct replaySample));
+    size_t filled = 0;
+    while (1) {
+        if (count == cap) {
+            cap *= 2;
+            samples = realloc(samples, cap * sizeof(struct replaySample));
+        }
+        ssize_t numBytes = read(resultFDs[0], (char *) &samples[count] + filled, sizeof(struct replaySample) - filled);
+        if (numBytes == -1 && errno == EINTR) {
+            continue;
+        }
+        if (numBytes <= 0) {
+            break;
+        }
+        filled += numBytes;
+        if (filled == sizeof(struct replaySample)) {
+            count++;
+            filled = 0;
+        }
+    }
+    close(resultFDs[0]);
+    for (i = 0; i < started; i++) {
+        int childExitStatus;
+        while (waitpid(workers[i], &childExitStatus, 0) == -1 && errno == EINTR) {
+            continue;
+        }
+    }
+    reportReplay(samples, count, monotonicNow() - start, started);
+    free(samples);
+    free(workers);
+    return 0;
+}
+
+/*
+* Run the recorded session in a copy of the shell, sending the time each command took to resultFD. A command's latency
+* runs from when it was due, so time spent behind schedule counts against it
+*/
+void replayWorker(double rate, long long start, int resultFD) {
+    // Commands read nothing from the terminal, and what they print is not part of the report
+    int nullFD = open("/dev/null", O_RDWR);
+    dup2(nullFD, STDIN_FILENO);
+    dup2(nullFD, STDOUT_FILENO);
+    dup2(nullFD, STDERR_FILENO);
+    close(nullFD);
+    // The copies are load, not the shell monitors are watching
+    jobTable = NULL;
+    reaper->start();
+
+    struct lineSource source = {0};
+    source.next = nextReplayLine;
+    long long firstTime = replayLines[0].time;
+    while (replayNext < replayCount && !inputs.exitShell) {
+        struct replayLine *line = &replayLines[replayNext];
+        replayNext++;
+        // The line is due at its time in the session, scaled by the rate; at the maximum rate it is due now
+        long long due = rate > 0 ? start + (long long) ((line->time - firstTime) / rate) : monotonicNow();
+        struct timespec dueTime = {due / 1000000000LL, due % 1000000000LL};
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &dueTime, NULL) == EINTR) {
+            continue;
+        }
+        reapBackground();
+        // Blank lines, comments and lines with syntax errors are not commands
+        if (line->text[0] == '\0' || line->text[0] == '#') {
+            continue;
+        }
+        resetScript(&lineScript);
+        int root = parseCommand(&lineScript, line->text, &source);
+        if (root < 0) {
+            continue;
+        }
+        struct replaySample sample;
+        memset(&sample, 0, sizeof(sample));
+        commandType(&lineScript, root, sample.type);
+        runNode(&lineScript, root);
+        inputs.background = 0;
+        inputs.inputFile = NULL;
+        inputs.inputData = NULL;
+        inputs.outputFile = NULL;
+        inputs.teeCount = 0;
+        arenaReset();
+        sample.latency = monotonicNow() - due;
+        write(resultFD, &sample, sizeof(sample));
+    }
+    shutdownJobs(inputs.shutdownTimeout, 0);
+    _exit(0);
+}
+
+/*
+* Name the type of a parsed command line for the replay report: the name of its first command, or "for" or "while"
+*/
+void commandType(struct script *script, int node, char *type) {
+    while (script->nodes[node].type == NODE_SEQ || script->nodes[node].type == NODE_AND || script->nodes[node].type == NODE_OR) {
+        node = script->nodes[node].left;
+    }
+    struct astNode *cmd = &script->nodes[node];
+    if (cmd->type == NODE_FOR || cmd->type == NODE_WHILE) {
+        strcpy(type, cmd->type == NODE_FOR ? "for" : "while");
+    }
+    else if (cmd->wordCount > 0) {
+        snprintf(type, REPLAY_TYPE_LENGTH, "%s", script->strings + script->words[cmd->wordStart].str);
+    }
+    else {
+        // A line with only redirections
+        strcpy(type, "-");
+    }
+}
+
+/*
+* Compare two replay samples for qsort(): by command type, then by latency
+*/
+int compareSamples(const void *a, const void *b) {
+    const struct replaySample *sampleA = a, *sampleB = b;
+    int order = strcmp(sampleA->type, sampleB->type);
+    if (order != 0) {
+        return order;
+    }
+    return (sampleA->latency > sampleB->latency) - (sampleA->latency < sampleB->latency);
+}
+
+/*
+* Print the replay report: overall throughput, then the throughput and latency percentiles of each command type
+*/
+void reportReplay(struct replaySample *samples, int count, long long elapsed, int concurrency) {
+    double seconds = elapsed / 1e9;
+    printf("%d commands from %d shells in %.3f s: %.1f commands/s\n", count, concurrency, seconds, count / seconds);
+    printf("%-16s %8s %10s %10s %10s %10s %10s\n", "command", "count", "per s", "p50 ms", "p90 ms", "p99 ms", "max ms");
+    qsort(samples, count, sizeof(struct replaySample), compareSamples);
+    int i, j;
+    for (i = 0; i < count; i = j) {
+        // Samples of one type are next to each other, in order of latency
+        for (j = i; j < count && strcmp(samples[j].type, samples[i].type) == 0; j++) {
+            continue;
+        }
+        printf("%-16s %8d %10.1f %10.3f %10.3f %10.3f %10.3f\n", samples[i].type, j - i, (j - i) / seconds,
+               percentile(samples + i, j - i, 50), percentile(samples + i, j - i, 90), percentile(samples + i, j - i, 99),
+               samples[j - 1].latency / 1e6);
+    }
+    fflush(stdout);
+}
+
+/*
+* Latency in milliseconds at a percentile of samples sorted by latency, by the nearest rank
+*/
+double percentile(struct replaySample *samples, int count, int percent) {
+    int rank = (percent * count + 99) / 100;
+    return samples[rank > 0 ? rank - 1 : 0].latency / 1e6;
+}
+
+/*
+* Signal handler for SIGINT while coproc-read waits: note it, so the read gives up
+*/
+void handleSIGINT(int signo) {
+    interrupted = 1;
+}
+
+/*
+* Signal handler for SIGTSTP
+*/
+void handleSIGTSTP(int signo) {
+    // If background processes are currently enabled, set background processes off
+    if (!inputs.backgroundOff) {
+        inputs.backgroundOff = 1;
+        char *message = "\nEntering foreground-only mode (& is now ignored)\n";
+        write(STDOUT_FILENO, message, 50);
+    }
+    // Else, background processes are currently disabled, set background processes on
+    else {
+        inputs.backgroundOff = 0;
+        char *message = "\nExiting foreground-only mode\n";
+        write(STDOUT_FILENO, message, 30);
+    }
+}
+
+/*
+* Signal handler for SIGUSR1: turn fgboost on or off
+*/
+void handleSIGUSR1(int signo) {
+    inputs.fgBoost = !inputs.fgBoost;
+    char *message = inputs.fgBoost ? "\nForeground priority mode on (background jobs yield to foreground commands)\n"
+                                   : "\nForeground priority mode off\n";
+    write(STDOUT_FILENO, message, strlen(message));
+}
+
+/*
+* Signal handler for SIGCHLD, used by the sigchld backend
+*/
+void handleSIGCHLD(int signo) {
+    // A child process of this parent process has terminated, stopped, or continued
+    int childStatus, childPid, exitStatus, j;
+    // Keep errno for the code this handler interrupted
+    int savedErrno = errno;
+    // Check every background process, as several can end for one SIGCHLD; foreground processes are left to their own waitpid
+    for (j = 0; j < PROCESS_LIMIT; j++) {
+        if (inputs.backgroundPids[j] == 0) {
+            continue;
+        }
+        // Non-blocking wait for the background process
+        childPid = waitpid(inputs.backgroundPids[j], &childStatus, WNOHANG);
+        // If waitpid did not return -1 or 0, the process was completed
+        if (childPid <= 0) {
+            continue;
+        }
+        // A process stopped by its timeout reports the timeout status
+        childStatus = timeoutStatus(childPid, childStatus);
+        recordReap(childPid, childStatus);
+        // Clear the background PID from the array since the process was completed
+        inputs.backgroundPids[j] = 0;
+
+        char *message1 = "background pid ";
+        // Write out message1 using non-reentrant function write()
+        write(STDOUT_FILENO, message1, 15);
+
+        // Write out childPid
+        int i = 1;
+        while (childPid / (i * 10) != 0) i *= 10;
+        for (; 0 < i; i /= 10) {
+            char c = (char) (childPid / i) + '0';
+            write(STDOUT_FILENO, &c, 1);
+            childPid = childPid % i;
+        }
+
+        // Check and set exit status
+        if (WIFEXITED(childStatus)) {
+            // If child terminated normally, print out the pid and the exit status
+            exitStatus = WEXITSTATUS(childStatus);
+            char *message2 = " is done: exit value ";
+            // Write out message2
+            write(STDOUT_FILENO, message2, 21);
+        }
+        else {
+            // If child terminated abnormally, print out the pid and the exit status
+            exitStatus = WTERMSIG(childStatus);
+            char *message2 = " is done: terminated by signal ";
+            // Write out message2
+            write(STDOUT_FILENO, message2, 31);
+        }
+
+        // Write out exit value
+        i = 1;
+        while (exitStatus / (i * 10) != 0) i *= 10;
+        for (; 0 < i; i /= 10) {
+            char c = (char) (exitStatus / i) + '0';
+            write(STDOUT_FILENO, &c, 1);
+            exitStatus = exitStatus % i;
+        }
+
+        char *message3 = "\n";
+        // Write out message3
+        write(STDOUT_FILENO, message3, 1);
+        // Wake a poll() on the self-pipe, as the slot can take a queued job
+        if (reaperWakeFD != -1) {
+            write(reaperWakeFD, "", 1);
+        }
+    }
+    errno = savedErrno;
+}
@@ -0,0 +1,1365 @@
+/* Parser of smallsh: tokenizes command lines into the nodes, words and string table of a script, and parses, folds
+   and evaluates arithmetic. It needs nothing else from the shell, so the fuzzer and benchmark link it alone */
+
+/* GNU extensions, such as memmem and open_memstream */
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include "smallsh.h"
+
+/* Token types */
+#define TOK_END 0
+#define TOK_WORD 1
+#define TOK_SEMI 2
+#define TOK_AND 3
+#define TOK_OR 4
+#define TOK_AMP 5
+#define TOK_LT 6
+#define TOK_GT 7
+#define TOK_NEWLINE 8
+#define TOK_HEREDOC 9
+#define TOK_HERESTRING 10
+#define TOK_TEE 11
+
+/* Arithmetic expression nodes */
+#define ARITH_NUM 0
+#define ARITH_VAR 1
+#define ARITH_UNARY 2
+#define ARITH_BINARY 3
+#define ARITH_TERNARY 4
+#define ARITH_ASSIGN 5
+
+/* Binary arithmetic operators, as indexes into arithOps */
+#define ARITH_LOR 0
+#define ARITH_LAND 1
+#define ARITH_BOR 2
+#define ARITH_XOR 3
+#define ARITH_BAND 4
+#define ARITH_EQ 5
+#define ARITH_NE 6
+#define ARITH_LE 7
+#define ARITH_GE 8
+#define ARITH_LT 9
+#define ARITH_GT 10
+#define ARITH_SHL 11
+#define ARITH_SHR 12
+#define ARITH_ADD 13
+#define ARITH_SUB 14
+#define ARITH_MUL 15
+#define ARITH_DIV 16
+#define ARITH_MOD 17
+#define ARITH_LEVELS 10
+
+/* Position in a command line being tokenized */
+struct lexer
+{
+    char *pos;       // Next character to read
+    int type;        // Type of the current token
+    char *text;      // Text of the current token
+    int len;         // Length of the current token
+    struct lineSource *source;  // Where to read more lines, or NULL
+    int depth;       // Number of loops open; the end of a line only ends the command outside loops
+    int priority;    // Priority of an "&N" token, or -1 if N is out of range
+};
+
+/* Binary arithmetic operator */
+struct arithOp
+{
+    char *text;      // How it is written
+    int level;       // Precedence; operators with higher levels bind tighter
+};
+
+/* Function prototypes */
+int parseList(struct script *script, struct lexer *lex);
+int parseAndOr(struct script *script, struct lexer *lex);
+int parseCommandNode(struct script *script, struct lexer *lex);
+int parseFor(struct script *script, struct lexer *lex);
+int parseWhile(struct script *script, struct lexer *lex);
+int parseLoopBody(struct script *script, struct lexer *lex);
+_Bool isKeyword(struct lexer *lex, char *keyword);
+int parseSimple(struct script *script, struct lexer *lex);
+char *readHereDoc(struct lexer *lex, char *delim, int delimLen, int *bodyLen, _Bool *quoted);
+int syntaxError(struct lexer *lex);
+void nextToken(struct lexer *lex);
+int addNode(struct script *script, int type, int left, int right);
+int addWord(struct script *script, char *text, int len);
+int addString(struct script *script, char *text, int len);
+void markBackground(struct script *script, int node, int priority);
+void addLine(struct script *script, int root);
+char *nextScriptLine(struct lineSource *source);
+char *splitLine(struct lineSource *source);
+char *foldArithmetic(char *text, int len, int *foldedLen);
+int parseArithAssign(struct arithExpr *expr);
+int parseArithTernary(struct arithExpr *expr);
+int parseArithBinary(struct arithExpr *expr, int level);
+int parseArithUnary(struct arithExpr *expr);
+int parseArithPrimary(struct arithExpr *expr);
+int matchArithOp(struct arithExpr *expr);
+int addArithNode(struct arithExpr *expr, int type, int op, int left, int right);
+int applyArith(int op, long long a, long long b, long long *result);
+int arithVar(struct arithExpr *expr, char *name, int len, long long *value);
+_Bool foldArith(struct arithExpr *expr, int node);
+int printArith(struct arithExpr *expr, int node, char *out);
+
+/* Global variables */
+struct arithOp arithOps[] = {
+    {"||", 1}, {"&&", 2}, {"|", 3}, {"^", 4}, {"&", 5}, {"==", 6}, {"!=", 6}, {"<=", 7}, {">=", 7}, {"<", 7}, {">", 7},
+    {"<<", 8}, {">>", 8}, {"+", 9}, {"-", 9}, {"*", 10}, {"/", 10}, {"%", 10},
+};
+
+/*
+* Parse a command line into a list of commands in script; a loop left open at the end of the line is continued
+* with lines from source. Returns the root node, -1 for a line with no commands, or -2 on a syntax error
+*/
+int parseCommand(struct script *script, char *userInput, struct lineSource *source) {
+    struct lexer lex;
+    lex.pos = userInput;
+    lex.source = source;
+    lex.depth = 0;
+    nextToken(&lex);
+
+    int root = parseList(script, &lex);
+    // Anything left over, such as a "done" with no loop, is an error
+    if (root != -2 && lex.type != TOK_END) {
+        return syntaxError(&lex);
+    }
+    return root;
+}
+
+/*
+* Parse and-or lists separated by ";", "&" or newlines, up to the end of input or a "do" or "done" keyword;
+* returns the root node, -1 if the list is empty, or -2 on a syntax error
+*/
+int parseList(struct script *script, struct lexer *lex) {
+    int root = -1;
+    while (1) {
+        // Skip empty lines between commands
+        while (lex->type == TOK_NEWLINE) {
+            nextToken(lex);
+        }
+        if (lex->type == TOK_END || isKeyword(lex, "do") || isKeyword(lex, "done")) {
+            break;
+        }
+        // Each item of the list is an and-or list ended by ";", "&", a newline, or what ends the list
+        int item = parseAndOr(script, lex);
+        if (item < 0) {
+            return -2;
+        }
+        if (lex->type == TOK_AMP) {
+            if (lex->priority < 0) {
+                return syntaxError(lex);
+            }
+            // Run the last command of the item in the background
+            markBackground(script, item, lex->priority);
+            nextToken(lex);
+        }
+        else if (lex->type == TOK_SEMI || lex->type == TOK_NEWLINE) {
+            nextToken(lex);
+        }
+        else if (lex->type != TOK_END && !isKeyword(lex, "do") && !isKeyword(lex, "done")) {
+            return syntaxError(lex);
+        }
+        // Chain the items in order with sequence nodes
+        root = root == -1 ? item : addNode(script, NODE_SEQ, root, item);
+    }
+    return root;
+}
+
+/*
+* Parse commands joined by "&&" and "||"; both operators have equal precedence and group left to right
+*/
+int parseAndOr(struct script *script, struct lexer *lex) {
+    int left = parseCommandNode(script, lex);
+    while (left >= 0 && (lex->type == TOK_AND || lex->type == TOK_OR)) {
+        int type = lex->type == TOK_AND ? NODE_AND : NODE_OR;
+        nextToken(lex);
+        // A command may follow the operator on the next line
+        while (lex->type == TOK_NEWLINE) {
+            nextToken(lex);
+        }
+        int right = parseCommandNode(script, lex);
+        if (right < 0) {
+            return right;
+        }
+        left = addNode(script, type, left, right);
+    }
+    return left;
+}
+
+/*
+* Parse a loop or a simple command
+*/
+int parseCommandNode(struct script *script, struct lexer *lex) {
+    if (isKeyword(lex, "for")) {
+        return parseFor(script, lex);
+    }
+    if (isKeyword(lex, "while")) {
+        return parseWhile(script, lex);
+    }
+    return parseSimple(script, lex);
+}
+
+/*
+* Parse "for NAME in WORDS; do LIST; done"; the words and body are parsed once and reused by every iteration
+*/
+int parseFor(struct script *script, struct lexer *lex) {
+    // Lines may be read past the end of this one until the matching "done"
+    lex->depth++;
+    nextToken(lex);
+    if (lex->type != TOK_WORD || !isName(lex->text, lex->len)) {
+        return syntaxError(lex);
+    }
+    int var = addWord(script, lex->text, lex->len);
+    nextToken(lex);
+    if (!isKeyword(lex, "in")) {
+        return syntaxError(lex);
+    }
+    nextToken(lex);
+
+    // The words to loop over directly follow the variable in the words array
+    int wordStart = script->wordCount;
+    while (lex->type == TOK_WORD) {
+        addWord(script, lex->text, lex->len);
+        nextToken(lex);
+    }
+    int wordCount = script->wordCount - wordStart;
+    if (lex->type != TOK_SEMI && lex->type != TOK_NEWLINE) {
+        return syntaxError(lex);
+    }
+    nextToken(lex);
+
+    int body = parseLoopBody(script, lex);
+    if (body < 0) {
+        return body;
+    }
+    int node = addNode(script, NODE_FOR, body, -1);
+    script->nodes[node].var = var;
+    script->nodes[node].wordStart = wordStart;
+    script->nodes[node].wordCount = wordCount;
+    return node;
+}
+
+/*
+* Parse "while LIST; do LIST; done"
+*/
+int parseWhile(struct script *script, struct lexer *lex) {
+    // Lines may be read past the end of this one until the matching "done"
+    lex->depth++;
+    nextToken(lex);
+    int condition = parseList(script, lex);
+    if (condition == -2) {
+        return -2;
+    }
+    if (condition == -1) {
+        return syntaxError(lex);
+    }
+    int body = parseLoopBody(script, lex);
+    if (body < 0) {
+        return body;
+    }
+    return addNode(script, NODE_WHILE, condition, body);
+}
+
+/*
+* Parse "do LIST; done" and leave the loop
+*/
+int parseLoopBody(struct script *script, struct lexer *lex) {
+    while (lex->type == TOK_NEWLINE) {
+        nextToken(lex);
+    }
+    if (!isKeyword(lex, "do")) {
+        return syntaxError(lex);
+    }
+    nextToken(lex);
+    int body = parseList(script, lex);
+    if (body == -2) {
+        return -2;
+    }
+    if (body == -1 || !isKeyword(lex, "done")) {
+        return syntaxError(lex);
+    }
+    // Leave the loop before reading on, so the end of the line ends the command
+    lex->depth--;
+    nextToken(lex);
+    return body;
+}
+
+/*
+* Check whether the current token is the given keyword
+*/
+_Bool isKeyword(struct lexer *lex, char *keyword) {
+    return lex->type == TOK_WORD && lex->len == (int) strlen(keyword) && strncmp(lex->text, keyword, lex->len) == 0;
+}
+
+/*
+* Check whether text is a valid variable name: a letter or underscore, then letters, digits or underscores
+*/
+_Bool isName(char *text, int len) {
+    int i;
+    if (len == 0 || !(isalpha((unsigned char) text[0]) || text[0] == '_')) {
+        return 0;
+    }
+    for (i = 1; i < len; i++) {
+        if (!(isalnum((unsigned char) text[i]) || text[i] == '_')) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/*
+* Parse a simple command: words, with "<", ">", "<<" and "<<<" redirections anywhere among them
+*/
+int parseSimple(struct script *script, struct lexer *lex) {
+    int node = addNode(script, NODE_SIMPLE, -1, -1);
+    script->nodes[node].wordStart = script->wordCount;
+    // Redirection targets are added after the command's words, so the words stay contiguous
+    char *inText = NULL, *outText = NULL;
+    int inLen = 0, outLen = 0;
+    char *teeText[TEE_LIMIT];
+    int teeLen[TEE_LIMIT];
+    int teeCount = 0;
+    // Text of a here-document or here-string, which replaces any earlier input redirection
+    char *hereText = NULL;
+    _Bool quoted = 0;
+    _Bool empty = 1;
+    while (1) {
+        if (lex->type == TOK_WORD) {
+            addWord(script, lex->text, lex->len);
+            script->nodes[node].wordCount++;
+        }
+        else if (lex->type == TOK_LT || lex->type == TOK_GT || lex->type == TOK_TEE || lex->type == TOK_HEREDOC || lex->type == TOK_HERESTRING) {
+            // The next word is the file to redirect from or to, the here-document delimiter, or the here-string
+            int redirect = lex->type;
+            nextToken(lex);
+            if (lex->type != TOK_WORD || (redirect == TOK_TEE && teeCount == TEE_LIMIT)) {
+                free(hereText);
+                return syntaxError(lex);
+            }
+            if (redirect == TOK_LT) {
+                inText = lex->text;
+                inLen = lex->len;
+                free(hereText);
+                hereText = NULL;
+            }
+            else if (redirect == TOK_GT) {
+                outText = lex->text;
+                outLen = lex->len;
+            }
+            else if (redirect == TOK_TEE) {
+                teeText[teeCount] = lex->text;
+                teeLen[teeCount] = lex->len;
+                teeCount++;
+            }
+            else {
+                free(hereText);
+                if (redirect == TOK_HEREDOC) {
+                    // The body is the lines that follow, up to the delimiter
+                    hereText = readHereDoc(lex, lex->text, lex->len, &inLen, &quoted);
+                }
+                else {
+                    // A here-string is the word and a newline
+                    hereText = malloc(lex->len + 2);
+                    memcpy(hereText, lex->text, lex->len);
+                    hereText[lex->len] = '\n';
+                    hereText[lex->len + 1] = '\0';
+                    inLen = lex->len + 1;
+                    quoted = 0;
+                }
+                inText = NULL;
+            }
+        }
+        else {
+            break;
+        }
+        empty = 0;
+        nextToken(lex);
+    }
+    if (empty) {
+        return syntaxError(lex);
+    }
+    if (inText != NULL) {
+        script->nodes[node].inputFile = addWord(script, inText, inLen);
+    }
+    if (hereText != NULL) {
+        // The text is expanded like a word when the command runs, unless the delimiter was quoted, but never globbed
+        int word = addWord(script, hereText, inLen);
+        script->words[word].flags = (script->words[word].flags & ~WORD_GLOB) | WORD_HEREDOC;
+        if (quoted) {
+            // The body stays as it was written, with no arithmetic folded into it
+            script->words[word].str = addString(script, hereText, inLen);
+            script->words[word].flags = WORD_HEREDOC;
+        }
+        script->nodes[node].inputFile = word;
+        free(hereText);
+    }
+    if (outText != NULL) {
+        script->nodes[node].outputFile = addWord(script, outText, outLen);
+    }
+    script->nodes[node].teeStart = script->wordCount;
+    script->nodes[node].teeCount = teeCount;
+    int i;
+    for (i = 0; i < teeCount; i++) {
+        addWord(script, teeText[i], teeLen[i]);
+    }
+    return node;
+}
+
+/*
+* Read the body of a here-document from the lines after the current one, up to a line that is just the delimiter.
+* A delimiter in quotes turns off variable expansion in the body. Returns the body, to be freed by the caller
+*/
+char *readHereDoc(struct lexer *lex, char *delim, int delimLen, int *bodyLen, _Bool *quoted) {
+    *quoted = delimLen >= 2 && (delim[0] == '\'' || delim[0] == '"') && delim[delimLen - 1] == delim[0];
+    if (*quoted) {
+        delim++;
+        delimLen -= 2;
+    }
+    size_t len = 0, cap = 256;
+    char *body = malloc(cap);
+    // Lines are read as they are, blank lines and comments included; with no lines to read, such as in "$(...)", the body is empty
+    char *line;
+    if (lex->source != NULL) {
+        lex->source->raw = 1;
+    }
+    while (lex->source != NULL && (line = lex->source->next(lex->source)) != NULL) {
+        size_t lineLen = strlen(line);
+        if (lineLen == (size_t) delimLen && strncmp(line, delim, delimLen) == 0) {
+            break;
+        }
+        while (len + lineLen + 2 > cap) {
+            cap *= 2;
+            body = realloc(body, cap);
+        }
+        memcpy(body + len, line, lineLen);
+        len += lineLen;
+        body[len] = '\n';
+        len++;
+    }
+    if (lex->source != NULL) {
+        lex->source->raw = 0;
+    }
+    body[len] = '\0';
+    *bodyLen = len;
+    return body;
+}
+
+/*
+* Print a syntax error for the current token and return -2
+*/
+int syntaxError(struct lexer *lex) {
+    if (lex->type == TOK_END) {
+        printf("smallsh: syntax error: unexpected end of line\n");
+    }
+    else if (lex->type == TOK_NEWLINE) {
+        printf("smallsh: syntax error: unexpected newline\n");
+    }
+    else {
+        printf("smallsh: syntax error near '%.*s'\n", lex->len, lex->text);
+    }
+    fflush(stdout);
+    return -2;
+}
+
+/*
+* Read the next token; operators are ";", "&&", "||", and "&", "<", "<<", "<<<" and ">" written as separate words
+*/
+void nextToken(struct lexer *lex) {
+    // Skip the spaces before the token
+    while (*lex->pos == ' ' || *lex->pos == '\t') {
+        lex->pos++;
+    }
+    char *start = lex->pos;
+    lex->text = start;
+    if (*start == '\0') {
+        // Inside a loop, the end of a line separates commands and parsing goes on with the next line
+        if (lex->depth > 0 && lex->source != NULL) {
+            char *line = lex->source->next(lex->source);
+            if (line != NULL) {
+                lex->pos = line;
+                lex->type = TOK_NEWLINE;
+                lex->len = 0;
+                return;
+            }
+        }
+        lex->type = TOK_END;
+        lex->len = 0;
+        return;
+    }
+    // ";", "&&" and "||" end a word wherever they appear
+    if (*start == ';') {
+        lex->type = TOK_SEMI;
+        lex->len = 1;
+        lex->pos++;
+        return;
+    }
+    if ((start[0] == '&' && start[1] == '&') || (start[0] == '|' && start[1] == '|')) {
+        lex->type = start[0] == '&' ? TOK_AND : TOK_OR;
+        lex->len = 2;
+        lex->pos += 2;
+        return;
+    }
+    // Read up to the next space or list operator; a command substitution is part of the word, spaces and operators included
+    char *end = start;
+    while (*end != '\0' && *end != ' ' && *end != '\t' && *end != ';' && !(end[0] == '&' && end[1] == '&') && !(end[0] == '|' && end[1] == '|')) {
+        char *close;
+        if (end[0] == '$' && end[1] == '(' && (close = matchParen(end + 1)) != NULL) {
+            end = close;
+        }
+        end++;
+    }
+    lex->len = end - start;
+    lex->pos = end;
+    // A lone "&", "<", ">" or ">+" is an operator, as is "&N" giving a background priority; anywhere else they are part of a word
+    if (*start == '&' && strspn(start + 1, "0123456789") == (size_t) lex->len - 1) {
+        lex->type = TOK_AMP;
+        lex->priority = 0;
+        if (lex->len > 1) {
+            // A priority that does not fit an int is marked for the parser to report
+            errno = 0;
+            long priority = strtol(start + 1, NULL, 10);
+            lex->priority = errno == ERANGE || priority > INT_MAX ? -1 : (int) priority;
+        }
+    }
+    else if (lex->len == 1 && *start == '<') {
+        lex->type = TOK_LT;
+    }
+    else if (lex->len == 2 && strncmp(start, "<<", 2) == 0) {
+        lex->type = TOK_HEREDOC;
+    }
+    else if (lex->len == 3 && strncmp(start, "<<<", 3) == 0) {
+        lex->type = TOK_HERESTRING;
+    }
+    else if (lex->len == 1 && *start == '>') {
+        lex->type = TOK_GT;
+    }
+    else if (lex->len == 2 && strncmp(start, ">+", 2) == 0) {
+        lex->type = TOK_TEE;
+    }
+    else {
+        lex->type = TOK_WORD;
+    }
+}
+
+/*
+* Add a node to the script and return its index
+*/
+int addNode(struct script *script, int type, int left, int right) {
+    if (script->nodeCount == script->nodeCap) {
+        script->nodeCap = script->nodeCap ? script->nodeCap * 2 : 16;
+        script->nodes = realloc(script->nodes, script->nodeCap * sizeof(struct astNode));
+    }
+    struct astNode *node = &script->nodes[script->nodeCount];
+    memset(node, 0, sizeof(struct astNode));
+    node->type = type;
+    node->left = left;
+    node->right = right;
+    node->inputFile = -1;
+    node->outputFile = -1;
+    node->var = -1;
+    script->nodeCount++;
+    return script->nodeCount - 1;
+}
+
+/*
+* Add a word to the script's string table and words array, noting which expansions it needs; returns its index
+*/
+int addWord(struct script *script, char *text, int len) {
+    if (script->wordCount == script->wordCap) {
+        script->wordCap = script->wordCap ? script->wordCap * 2 : 32;
+        script->words = realloc(script->words, script->wordCap * sizeof(struct astWord));
+    }
+    struct astWord *word = &script->words[script->wordCount];
+    // Work out the constant parts of arithmetic expansions now, rather than each time the word runs
+    int foldedLen;
+    char *folded = foldArithmetic(text, len, &foldedLen);
+    if (folded != NULL) {
+        text = folded;
+        len = foldedLen;
+    }
+    word->str = addString(script, text, len);
+    free(folded);
+    word->flags = 0;
+    // Decide once, at parse time, which words need expanding when they run
+    char *str = script->strings + word->str;
+    if (strstr(str, "$$") != NULL) {
+        word->flags |= WORD_PID;
+    }
+    char *dollar;
+    for (dollar = strchr(str, '$'); dollar != NULL; dollar = strchr(dollar + 1, '$')) {
+        if (isalpha((unsigned char) dollar[1]) || dollar[1] == '_' || dollar[1] == '{') {
+            word->flags |= WORD_VAR;
+        }
+    }
+    char *close;
+    if (nextSubstitution(str, &close) != NULL) {
+        word->flags |= WORD_CMDSUB;
+    }
+    for (dollar = strstr(str, "$(("); dollar != NULL; dollar = strstr(dollar + 1, "$((")) {
+        if (matchArith(dollar) != NULL) {
+            word->flags |= WORD_ARITH;
+        }
+    }
+    if (strpbrk(str, "*?[") != NULL) {
+        word->flags |= WORD_GLOB;
+    }
+    script->wordCount++;
+    return script->wordCount - 1;
+}
+
+/*
+* Copy a string into the script's string table and return its offset
+*/
+int addString(struct script *script, char *text, int len) {
+    while (script->stringLen + len + 1 > script->stringCap) {
+        script->stringCap = script->stringCap ? script->stringCap * 2 : 256;
+        script->strings = realloc(script->strings, script->stringCap);
+    }
+    int offset = script->stringLen;
+    memcpy(script->strings + offset, text, len);
+    script->strings[offset + len] = '\0';
+    script->stringLen += len + 1;
+    return offset;
+}
+
+/*
+* Mark the last simple command of an and-or list to run in the background with the given admission priority;
+* loops always run in the foreground
+*/
+void markBackground(struct script *script, int node, int priority) {
+    while (script->nodes[node].type == NODE_AND || script->nodes[node].type == NODE_OR) {
+        node = script->nodes[node].right;
+    }
+    if (script->nodes[node].type == NODE_SIMPLE) {
+        script->nodes[node].background = 1;
+        script->nodes[node].priority = priority;
+    }
+}
+
+/*
+* Empty a script so it can hold the next command line, keeping its memory
+*/
+void resetScript(struct script *script) {
+    script->nodeCount = 0;
+    script->wordCount = 0;
+    script->stringLen = 0;
+}
+
+/*
+* Parse every line of a script's text; a loop may span several lines. Returns the number of syntax errors
+*/
+int compileScript(char *text, struct script *script) {
+    int errors = 0;
+    struct lineSource source = {0};
+    source.next = nextScriptLine;
+    source.text = text;
+    char *line;
+    while ((line = nextScriptLine(&source)) != NULL) {
+        int root = parseCommand(script, line, &source);
+        if (root == -2) {
+            errors++;
+        }
+        if (root != -1) {
+            addLine(script, root);
+        }
+    }
+    return errors;
+}
+
+/*
+* Add the root node of a line to a script
+*/
+void addLine(struct script *script, int root) {
+    if (script->lineCount == script->lineCap) {
+        script->lineCap = script->lineCap ? script->lineCap * 2 : 64;
+        script->lines = realloc(script->lines, script->lineCap * sizeof(int));
+    }
+    script->lines[script->lineCount] = root;
+    script->lineCount++;
+}
+
+/*
+* Free a script, or unmap it if it was loaded from the cache
+*/
+void freeScript(struct script *script) {
+    if (script->map != NULL) {
+        munmap(script->map, script->mapSize);
+    }
+    else {
+        free(script->nodes);
+        free(script->words);
+        free(script->strings);
+        free(script->lines);
+    }
+    memset(script, 0, sizeof(struct script));
+}
+
+/*
+* Line source for a script file: the next line with a command, or in raw mode the next line as it is
+*/
+char *nextScriptLine(struct lineSource *source) {
+    char *line;
+    while ((line = splitLine(source)) != NULL) {
+        if (source->raw) {
+            return line;
+        }
+        // Remove any extra whitespace at the end of the line
+        int i = strlen(line) - 1;
+        while (i >= 0 && (line[i] == ' ' || line[i] == '\r')) {
+            line[i] = '\0';
+            i--;
+        }
+        // Blank lines and comments are left out
+        if (line[0] != '\0' && line[0] != '#') {
+            return line;
+        }
+    }
+    return NULL;
+}
+
+/*
+* Cut the next line out of the script text, blank lines included; returns NULL at the end of the text
+*/
+char *splitLine(struct lineSource *source) {
+    // The text is set to start reading, like the first call to strtok_r()
+    if (source->text != NULL) {
+        source->saveptr = source->text;
+        source->text = NULL;
+    }
+    char *line = source->saveptr;
+    if (line == NULL || *line == '\0') {
+        return NULL;
+    }
+    char *end = strchr(line, '\n');
+    if (end != NULL) {
+        *end = '\0';
+        source->saveptr = end + 1;
+    }
+    else {
+        source->saveptr = line + strlen(line);
+    }
+    return line;
+}
+
+/*
+* Find the next command substitution "$(...)" in text, setting close to its ")"; returns NULL if there is none
+*/
+char *nextSubstitution(char *text, char **close) {
+    char *open;
+    for (open = strstr(text, "$("); open != NULL; open = strstr(open + 1, "$(")) {
+        // Arithmetic "$((...))" is not a substitution, though there may be one inside it
+        if (open[2] == '(' && matchArith(open) != NULL) {
+            continue;
+        }
+        *close = matchParen(open + 1);
+        if (*close != NULL) {
+            return open;
+        }
+    }
+    return NULL;
+}
+
+/*
+* Find the ")" matching the "(" at open, counting the parentheses nested inside; returns NULL if it is missing
+*/
+char *matchParen(char *open) {
+    int depth = 0;
+    char *c;
+    for (c = open; *c != '\0'; c++) {
+        if (*c == '(') {
+            depth++;
+        }
+        else if (*c == ')') {
+            depth--;
+            if (depth == 0) {
+                return c;
+            }
+        }
+    }
+    return NULL;
+}
+
+/*
+* Find the end of the arithmetic expansion "$((...))" starting at open: the last ")" of the "))" that matches its "((";
+* returns NULL if open does not start one
+*/
+char *matchArith(char *open) {
+    if (open[0] != '$' || open[1] != '(' || open[2] != '(') {
+        return NULL;
+    }
+    char *inner = matchParen(open + 2);
+    if (inner == NULL || inner[1] != ')') {
+        return NULL;
+    }
+    return inner + 1;
+}
+
+/*
+* Fold the constant parts of the arithmetic expansions in a word as it is parsed: an expansion of constants becomes its
+* value, and one with variables keeps only the parts that need them. Expansions with "$" inside are left for run time,
+* as are errors such as division by zero, to be reported then. Returns the new text, to be freed by the caller, or NULL
+* if nothing changed
+*/
+char *foldArithmetic(char *text, int len, int *foldedLen) {
+    // Most words have no arithmetic, so look before copying
+    if (memmem(text, len, "$((", 3) == NULL) {
+        return NULL;
+    }
+    char *src = strndup(text, len);
+    char *buffer = NULL;
+    size_t size = 0;
+    FILE *out = open_memstream(&buffer, &size);
+    _Bool changed = 0;
+    char *c = src;
+    while (*c != '\0') {
+        char *close = matchArith(c);
+        if (close == NULL) {
+            fputc(*c, out);
+            c++;
+            continue;
+        }
+        // Work on the expression between "$((" and "))"
+        *(close - 1) = '\0';
+        char *inner = c + 3;
+        struct arithExpr expr;
+        expr.nodes = NULL;
+        int root = -1;
+        if (strchr(inner, '$') == NULL) {
+            root = parseArith(&expr, inner);
+        }
+        if (root == -1) {
+            // Needs expanding first, or has an error to report when it runs; nested expansions can still be folded
+            free(expr.nodes);
+            *(close - 1) = ')';
+            fputs("$((", out);
+            c += 3;
+            continue;
+        }
+        if (foldArith(&expr, root)) {
+            fprintf(out, "%lld", expr.nodes[root].value);
+        }
+        else {
+            // Binary operators print in parentheses, which the outermost one can do without
+            char *folded = malloc(expr.count * 32 + strlen(inner) + 1);
+            int foldedEnd = printArith(&expr, root, folded);
+            _Bool outer = expr.nodes[root].type >= ARITH_BINARY;
+            fprintf(out, "$((%.*s))", foldedEnd - 2 * outer, folded + outer);
+            free(folded);
+        }
+        free(expr.nodes);
+        changed = 1;
+        c = close + 1;
+    }
+    fclose(out);
+    free(src);
+    if (!changed) {
+        free(buffer);
+        return NULL;
+    }
+    *foldedLen = size;
+    return buffer;
+}
+
+/*
+* Parse an arithmetic expression into expr, whose nodes the caller frees; returns the root node, or -1 on an error
+*/
+int parseArith(struct arithExpr *expr, char *text) {
+    // Every node takes at least one character, so the expression needs no more nodes than it has characters
+    expr->nodes = malloc((strlen(text) + 1) * sizeof(struct arithNode));
+    expr->count = 0;
+    expr->pos = text;
+    expr->error = ARITH_OK;
+    // Variables read as unset and assignments are dropped until the caller gives the expression its variables
+    expr->readVar = NULL;
+    expr->writeVar = NULL;
+    int root = parseArithAssign(expr);
+    while (*expr->pos == ' ' || *expr->pos == '\t' || *expr->pos == '\n') {
+        expr->pos++;
+    }
+    // Anything left over, such as an unmatched ")", is an error
+    if (root != -1 && *expr->pos != '\0') {
+        expr->error = ARITH_SYNTAX;
+        root = -1;
+    }
+    return root;
+}
+
+/*
+* Parse an assignment, "NAME = expr" or "NAME op= expr", or else a conditional expression
+*/
+int parseArithAssign(struct arithExpr *expr) {
+    char *start = expr->pos;
+    while (*start == ' ' || *start == '\t' || *start == '\n') {
+        start++;
+    }
+    char *c = start;
+    while (isalnum((unsigned char) *c) || *c == '_') {
+        c++;
+    }
+    if (c > start && isName(start, c - start)) {
+        char *name = start;
+        int nameLen = c - start;
+        while (*c == ' ' || *c == '\t' || *c == '\n') {
+            c++;
+        }
+        // "=" on its own, or after an arithmetic operator such as "+=", but not "=="
+        int op = -1;
+        if (c[0] != '\0' && strchr("+-*/%", c[0]) != NULL && c[1] == '=') {
+            expr->pos = c;
+            op = matchArithOp(expr);
+        }
+        if (op != -1 || (c[0] == '=' && c[1] != '=')) {
+            expr->pos = c + (op != -1 ? 1 : 0) + 1;
+            int value = parseArithAssign(expr);
+            if (value == -1) {
+                return -1;
+            }
+            int node = addArithNode(expr, ARITH_ASSIGN, op, value, -1);
+            expr->nodes[node].name = name;
+            expr->nodes[node].nameLen = nameLen;
+            return node;
+        }
+    }
+    expr->pos = start;
+    return parseArithTernary(expr);
+}
+
+/*
+* Parse a conditional expression, "cond ? expr : expr", or else a binary expression
+*/
+int parseArithTernary(struct arithExpr *expr) {
+    int cond = parseArithBinary(expr, 1);
+    if (cond == -1) {
+        return -1;
+    }
+    while (*expr->pos == ' ' || *expr->pos == '\t' || *expr->pos == '\n') {
+        expr->pos++;
+    }
+    if (*expr->pos != '?') {
+        return cond;
+    }
+    expr->pos++;
+    int then = parseArithAssign(expr);
+    if (then == -1) {
+        return -1;
+    }
+    while (*expr->pos == ' ' || *expr->pos == '\t' || *expr->pos == '\n') {
+        expr->pos++;
+    }
+    if (*expr->pos != ':') {
+        expr->error = ARITH_SYNTAX;
+        return -1;
+    }
+    expr->pos++;
+    int otherwise = parseArithAssign(expr);
+    if (otherwise == -1) {
+        return -1;
+    }
+    int node = addArithNode(expr, ARITH_TERNARY, -1, cond, then);
+    expr->nodes[node].third = otherwise;
+    return node;
+}
+
+/*
+* Parse binary operators of the given precedence level and up, left to right
+*/
+int parseArithBinary(struct arithExpr *expr, int level) {
+    if (level > ARITH_LEVELS) {
+        return parseArithUnary(expr);
+    }
+    int left = parseArithBinary(expr, level + 1);
+    while (left != -1) {
+        // Only an operator of this level continues the expression here
+        char *start = expr->pos;
+        int op = matchArithOp(expr);
+        if (op == -1 || arithOps[op].level != level) {
+            expr->pos = start;
+            break;
+        }
+        int right = parseArithBinary(expr, level + 1);
+        if (right == -1) {
+            return -1;
+        }
+        left = addArithNode(expr, ARITH_BINARY, op, left, right);
+    }
+    return left;
+}
+
+/*
+* Parse a unary "-", "+", "!" or "~" and its operand, or else a number, variable or parenthesized expression
+*/
+int parseArithUnary(struct arithExpr *expr) {
+    while (*expr->pos == ' ' || *expr->pos == '\t' || *expr->pos == '\n') {
+        expr->pos++;
+    }
+    char op = *expr->pos;
+    if (op == '-' || op == '+' || op == '!' || op == '~') {
+        expr->pos++;
+        int operand = parseArithUnary(expr);
+        if (operand == -1 || op == '+') {
+            return operand;
+        }
+        return addArithNode(expr, ARITH_UNARY, op, operand, -1);
+    }
+    return parseArithPrimary(expr);
+}
+
+/*
+* Parse a number, a variable name or a parenthesized expression
+*/
+int parseArithPrimary(struct arithExpr *expr) {
+    char *c = expr->pos;
+    if (*c == '(') {
+        expr->pos++;
+        int node = parseArithAssign(expr);
+        if (node == -1) {
+            return -1;
+        }
+        while (*expr->pos == ' ' || *expr->pos == '\t' || *expr->pos == '\n') {
+            expr->pos++;
+        }
+        if (*expr->pos != ')') {
+            expr->error = ARITH_SYNTAX;
+            return -1;
+        }
+        expr->pos++;
+        return node;
+    }
+    if (isdigit((unsigned char) *c)) {
+        // Decimal, or hexadecimal with "0x" and octal with a leading "0"
+        char *end;
+        errno = 0;
+        long long value = strtoll(c, &end, 0);
+        if (errno == ERANGE) {
+            expr->error = ARITH_OVERFLOW;
+            return -1;
+        }
+        if (isalnum((unsigned char) *end) || *end == '_') {
+            expr->error = ARITH_SYNTAX;
+            return -1;
+        }
+        expr->pos = end;
+        int node = addArithNode(expr, ARITH_NUM, -1, -1, -1);
+        expr->nodes[node].value = value;
+        return node;
+    }
+    if (isalpha((unsigned char) *c) || *c == '_') {
+        while (isalnum((unsigned char) *expr->pos) || *expr->pos == '_') {
+            expr->pos++;
+        }
+        int node = addArithNode(expr, ARITH_VAR, -1, -1, -1);
+        expr->nodes[node].name = c;
+        expr->nodes[node].nameLen = expr->pos - c;
+        return node;
+    }
+    expr->error = ARITH_SYNTAX;
+    return -1;
+}
+
+/*
+* Read the longest binary operator at the position, after any spaces; returns its index in arithOps, or -1
+*/
+int matchArithOp(struct arithExpr *expr) {
+    while (*expr->pos == ' ' || *expr->pos == '\t' || *expr->pos == '\n') {
+        expr->pos++;
+    }
+    int best = -1, i;
+    for (i = 0; i < (int) (sizeof(arithOps) / sizeof(arithOps[0])); i++) {
+        int len = strlen(arithOps[i].text);
+        if (strncmp(expr->pos, arithOps[i].text, len) == 0 && (best == -1 || len > (int) strlen(arithOps[best].text))) {
+            best = i;
+        }
+    }
+    if (best != -1) {
+        expr->pos += strlen(arithOps[best].text);
+    }
+    return best;
+}
+
+/*
+* Add a node to an arithmetic expression and return its index
+*/
+int addArithNode(struct arithExpr *expr, int type, int op, int left, int right) {
+    struct arithNode *node = &expr->nodes[expr->count];
+    memset(node, 0, sizeof(struct arithNode));
+    node->type = type;
+    node->op = op;
+    node->left = left;
+    node->right = right;
+    node->third = -1;
+    expr->count++;
+    return expr->count - 1;
+}
+
+/*
+* Evaluate a node of an arithmetic expression; "&&", "||" and "?:" only evaluate the operands they need.
+* Returns ARITH_OK or the error
+*/
+int evalArith(struct arithExpr *expr, int node, long long *value) {
+    struct arithNode *n = &expr->nodes[node];
+    long long a, b;
+    int error;
+    switch (n->type) {
+        case ARITH_NUM: {
+            *value = n->value;
+            return ARITH_OK;
+        }
+        case ARITH_VAR: {
+            return arithVar(expr, n->name, n->nameLen, value);
+        }
+        case ARITH_UNARY: {
+            if ((error = evalArith(expr, n->left, &a)) != ARITH_OK) {
+                return error;
+            }
+            if (n->op == '-') {
+                if (a == LLONG_MIN) {
+                    return ARITH_OVERFLOW;
+                }
+                *value = -a;
+            }
+            else {
+                *value = n->op == '!' ? !a : ~a;
+            }
+            return ARITH_OK;
+        }
+        case ARITH_TERNARY: {
+            if ((error = evalArith(expr, n->left, &a)) != ARITH_OK) {
+                return error;
+            }
+            return evalArith(expr, a ? n->right : n->third, value);
+        }
+        case ARITH_ASSIGN: {
+            if ((error = evalArith(expr, n->left, &b)) != ARITH_OK) {
+                return error;
+            }
+            // A compound assignment applies its operator to the variable's value first
+            if (n->op != -1 && ((error = arithVar(expr, n->name, n->nameLen, &a)) != ARITH_OK || (error = applyArith(n->op, a, b, &b)) != ARITH_OK)) {
+                return error;
+            }
+            char name[n->nameLen + 1];
+            memcpy(name, n->name, n->nameLen);
+            name[n->nameLen] = '\0';
+            char text[MAX_LLONG_LENGTH + 1];
+            sprintf(text, "%lld", b);
+            if (expr->writeVar != NULL) {
+                expr->writeVar(name, text);
+            }
+            *value = b;
+            return ARITH_OK;
+        }
+        default: {
+            if ((error = evalArith(expr, n->left, &a)) != ARITH_OK) {
+                return error;
+            }
+            // The right side of "&&" and "||" is only evaluated when it decides the result
+            if (n->op == ARITH_LAND && !a) {
+                *value = 0;
+                return ARITH_OK;
+            }
+            if (n->op == ARITH_LOR && a) {
+                *value = 1;
+                return ARITH_OK;
+            }
+            if ((error = evalArith(expr, n->right, &b)) != ARITH_OK) {
+                return error;
+            }
+            return applyArith(n->op, a, b, value);
+        }
+    }
+}
+
+/*
+* Apply a binary operator to two values, checking for division by zero and overflow; returns ARITH_OK or the error
+*/
+int applyArith(int op, long long a, long long b, long long *result) {
+    switch (op) {
+        case ARITH_LOR: *result = a || b; break;
+        case ARITH_LAND: *result = a && b; break;
+        case ARITH_BOR: *result = a | b; break;
+        case ARITH_XOR: *result = a ^ b; break;
+        case ARITH_BAND: *result = a & b; break;
+        case ARITH_EQ: *result = a == b; break;
+        case ARITH_NE: *result = a != b; break;
+        case ARITH_LE: *result = a <= b; break;
+        case ARITH_GE: *result = a >= b; break;
+        case ARITH_LT: *result = a < b; break;
+        case ARITH_GT: *result = a > b; break;
+        case ARITH_ADD: return __builtin_add_overflow(a, b, result) ? ARITH_OVERFLOW : ARITH_OK;
+        case ARITH_SUB: return __builtin_sub_overflow(a, b, result) ? ARITH_OVERFLOW : ARITH_OK;
+        case ARITH_MUL: return __builtin_mul_overflow(a, b, result) ? ARITH_OVERFLOW : ARITH_OK;
+        case ARITH_SHL: {
+            // Shifting a bit out of the value is an overflow, as is shifting by the width or more
+            if (b < 0 || b > 63) {
+                return ARITH_OVERFLOW;
+            }
+            *result = (long long) ((unsigned long long) a << b);
+            if (*result >> b != a) {
+                return ARITH_OVERFLOW;
+            }
+            break;
+        }
+        case ARITH_SHR: {
+            if (b < 0 || b > 63) {
+                return ARITH_OVERFLOW;
+            }
+            *result = a >> b;
+            break;
+        }
+        default: {
+            // Division and remainder
+            if (b == 0) {
+                return ARITH_DIVZERO;
+            }
+            if (a == LLONG_MIN && b == -1) {
+                return ARITH_OVERFLOW;
+            }
+            *result = op == ARITH_DIV ? a / b : a % b;
+            break;
+        }
+    }
+    return ARITH_OK;
+}
+
+/*
+* Read a variable as a number; an unset or empty variable is 0
+*/
+int arithVar(struct arithExpr *expr, char *name, int len, long long *value) {
+    char *text = expr->readVar != NULL ? expr->readVar(name, len) : "";
+    char *end;
+    errno = 0;
+    *value = strtoll(text, &end, 0);
+    if (errno == ERANGE) {
+        return ARITH_OVERFLOW;
+    }
+    if (*end != '\0') {
+        expr->errorName = name;
+        expr->errorLen = len;
+        return ARITH_NOTNUMBER;
+    }
+    return ARITH_OK;
+}
+
+/*
+* Fold the constant operations of an expression into numbers, leaving any that fail to be reported when it runs;
+* returns 1 if the node became a number
+*/
+_Bool foldArith(struct arithExpr *expr, int node) {
+    struct arithNode *n = &expr->nodes[node];
+    if (n->type == ARITH_NUM) {
+        return 1;
+    }
+    if (n->type == ARITH_VAR) {
+        return 0;
+    }
+    // Fold every operand, then this node if they are all numbers; an assignment always runs
+    _Bool constant = foldArith(expr, n->left);
+    if (n->right != -1) {
+        constant = foldArith(expr, n->right) && constant;
+    }
+    if (n->third != -1) {
+        constant = foldArith(expr, n->third) && constant;
+    }
+    long long value;
+    if (!constant || n->type == ARITH_ASSIGN || evalArith(expr, node, &value) != ARITH_OK) {
+        return 0;
+    }
+    n->type = ARITH_NUM;
+    n->value = value;
+    return 1;
+}
+
+/*
+* Write an expression back out as text, with binary operators in parentheses; returns the length written
+*/
+int printArith(struct arithExpr *expr, int node, char *out) {
+    struct arithNode *n = &expr->nodes[node];
+    int len = 0;
+    switch (n->type) {
+        case ARITH_NUM: {
+            // Negative numbers are written as a negation, which the smallest one overflows
+            if (n->value == LLONG_MIN) {
+                return sprintf(out, "(-9223372036854775807-1)");
+            }
+            return sprintf(out, n->value < 0 ? "(%lld)" : "%lld", n->value);
+        }
+        case ARITH_VAR: {
+            return sprintf(out, "%.*s", n->nameLen, n->name);
+        }
+        case ARITH_UNARY: {
+            out[0] = n->op;
+            return 1 + printArith(expr, n->left, out + 1);
+        }
+        case ARITH_TERNARY: {
+            len += sprintf(out, "(");
+            len += printArith(expr, n->left, out + len);
+            len += sprintf(out + len, "?");
+            len += printArith(expr, n->right, out + len);
+            len += sprintf(out + len, ":");
+            len += printArith(expr, n->third, out + len);
+            return len + sprintf(out + len, ")");
+        }
+        case ARITH_ASSIGN: {
+            len += sprintf(out, "(%.*s%s=", n->nameLen, n->name, n->op != -1 ? arithOps[n->op].text : "");
+            len += printArith(expr, n->left, out + len);
+            return len + sprintf(out + len, ")");
+        }
+        default: {
+            len += sprintf(out, "(");
+            len += printArith(expr, n->left, out + len);
+            len += sprintf(out + len, "%s", arithOps[n->op].text);
+            len += printArith(expr, n->right, out + len);
+            return len + sprintf(out + len, ")");
+        }
+    }
+}
+
+/*
+* Replace each "$$" in token with the shell's PID, pairing the "$" characters from the left, so "$$$" keeps its last
+* "$"; returns a new string for the caller to free
+*/
+char *varExp(char *token, int shellPid) {
+    // Convert shell's PID to string
+    char shellPidStr[MAX_PID_LENGTH + 1];
+    size_t pidLen = sprintf(shellPidStr, "%d", shellPid);
+
+    // Count the "$$" pairs to replace the same way they are replaced below, so an odd "$" is not counted as half a pair
+    size_t tokenLen = strlen(token);
+    size_t dollarNum = 0;
+    size_t i;
+    for (i = 0; i + 1 < tokenLen; i++) {
+        if (token[i] == '$' && token[i + 1] == '$') {
+            dollarNum++;
+            i++;
+        }
+    }
+
+    // Malloc memory for the new string, with room for the terminating '\0'
+    char *newToken = malloc(tokenLen - 2 * dollarNum + pidLen * dollarNum + 1);
+    char *newTokenPtr = newToken;
+
+    // Iterate over the original string and replace "$$" instances with the shell PID
+    i = 0;
+    while (i < tokenLen) {
+        // Replace "$$" with shell PID
+        if (token[i] == '$' && token[i + 1] == '$') {
+            memcpy(newTokenPtr, shellPidStr, pidLen);
+            newTokenPtr += pidLen;
+            i = i + 2;
+        }
+        // Else, copy over the single char
+        else {
+            *newTokenPtr = token[i];
+            newTokenPtr++;
+            i++;
+        }
+    }
+    *newTokenPtr = '\0';
+    // newToken holds new variable after expansion
+    return newToken;
+}
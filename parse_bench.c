@@ -0,0 +1,103 @@
+/* Parser throughput benchmark for smallsh: parses millions of synthetic command lines the way the shell parses the
+   lines it reads, and reports lines per second and heap allocations per line */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "smallsh.h"
+
+/* Define macros */
+#define BENCH_LINES 2000000
+#define BENCH_VARIANTS 1024
+#define BENCH_LINE_LENGTH 256
+
+/* glibc's allocator, called by the counting wrappers below */
+void *__libc_malloc(size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+void *__libc_calloc(size_t count, size_t size);
+
+/* Global variables */
+long long allocations = 0;  // Calls to malloc, realloc and calloc, counted while the benchmark runs
+_Bool counting = 0;         // Flag set while the parse loop runs
+
+/*
+* Count an allocation made while timing
+*/
+void *malloc(size_t size) {
+    allocations += counting;
+    return __libc_malloc(size);
+}
+
+/*
+* Count a reallocation made while timing
+*/
+void *realloc(void *ptr, size_t size) {
+    allocations += counting;
+    return __libc_realloc(ptr, size);
+}
+
+/*
+* Count a zeroed allocation made while timing
+*/
+void *calloc(size_t count, size_t size) {
+    allocations += counting;
+    return __libc_calloc(count, size);
+}
+
+/*
+* Run the benchmark: "parse_bench [LINES]"
+*/
+int main(int argc, char *argv[]) {
+    long lineTotal = argc > 1 ? atol(argv[1]) : BENCH_LINES;
+    if (lineTotal <= 0) {
+        fprintf(stderr, "usage: parse_bench [LINES]\n");
+        return 2;
+    }
+
+    // Lines like the ones typed at the prompt: plain commands, lists, redirections, expansions, loops and arithmetic
+    char *templates[] = {
+        "ls -la /tmp/dir%d",
+        "echo $HOME $$ ${USER}_%d && cat notes%d.txt || echo missing",
+        "grep -n pattern%d main.c < input.txt > matches.txt &",
+        "for f in a b c d%d; do echo $f; done",
+        "sort data%d.csv > sorted.csv ; wc -l sorted.csv",
+        "echo $((%d * 4 + n)) $((1 << 10))",
+        "cmd%d one two three four five six seven eight nine ten",
+        "timeout 5 sleep %d &2",
+    };
+    int templateCount = sizeof(templates) / sizeof(templates[0]);
+    char *lines = malloc((size_t) BENCH_VARIANTS * BENCH_LINE_LENGTH);
+    size_t lengths[BENCH_VARIANTS];
+    size_t bytes = 0;
+    int i;
+    for (i = 0; i < BENCH_VARIANTS; i++) {
+        char *line = lines + (size_t) i * BENCH_LINE_LENGTH;
+        lengths[i] = snprintf(line, BENCH_LINE_LENGTH, templates[i % templateCount], i, i) + 1;
+    }
+
+    // Parse the lines over and over into one script, emptied before each line as the shell does
+    struct script script = {0};
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    counting = 1;
+    long n;
+    for (n = 0; n < lineTotal; n++) {
+        int variant = n % BENCH_VARIANTS;
+        char *line = lines + (size_t) variant * BENCH_LINE_LENGTH;
+        resetScript(&script);
+        if (parseCommand(&script, line, NULL) < 0) {
+            fprintf(stderr, "parse_bench: could not parse: %s\n", line);
+            return 1;
+        }
+        bytes += lengths[variant];
+    }
+    counting = 0;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    printf("parsed %ld lines (%.1f MB) in %.3f s\n", lineTotal, bytes / 1e6, seconds);
+    printf("%.0f lines/s, %.1f MB/s, %.3f allocations/line\n", lineTotal / seconds, bytes / 1e6 / seconds, (double) allocations / lineTotal);
+    freeScript(&script);
+    free(lines);
+    return 0;
+}
@@ -0,0 +1,101 @@
+/* Fuzz entry point for the smallsh parser: each input is parsed as a script, then every word it yields goes through the
+   parser's own word handling: "$$" expansion, arithmetic and the commands inside "$(...)".
+   Built with clang -fsanitize=fuzzer it runs under libFuzzer; otherwise main() below runs it on files or stdin */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "smallsh.h"
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+void fuzzWords(struct script *script);
+
+/*
+* Parse the input as a script, then work through the words it yields
+*/
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    // The parser works on a C string, so the input ends at its first NUL
+    char *text = malloc(size + 1);
+    memcpy(text, data, size);
+    text[size] = '\0';
+    struct script script = {0};
+    compileScript(text, &script);
+    fuzzWords(&script);
+    freeScript(&script);
+    free(text);
+    return 0;
+}
+
+/*
+* Take every word of a script, whatever its flags, through "$$" expansion; parse and evaluate each arithmetic expansion
+* in it with every variable unset, and parse the commands of each "$(...)" as the shell would before running them,
+* going on into their words. Running commands and matching globs are left out, as they are the shell's, not the parser's
+*/
+void fuzzWords(struct script *script) {
+    int i;
+    for (i = 0; i < script->wordCount; i++) {
+        char *text = script->strings + script->words[i].str;
+        free(varExp(text, 12345));
+
+        char *open, *close;
+        for (open = strstr(text, "$(("); open != NULL; open = strstr(open + 1, "$((")) {
+            close = matchArith(open);
+            if (close == NULL) {
+                continue;
+            }
+            // The expression runs from after "$((" to before "))"
+            char *expression = strndup(open + 3, close - open - 4);
+            struct arithExpr expr;
+            long long value;
+            int root = parseArith(&expr, expression);
+            if (root != -1) {
+                evalArith(&expr, root, &value);
+            }
+            free(expr.nodes);
+            free(expression);
+        }
+
+        for (open = nextSubstitution(text, &close); open != NULL; open = nextSubstitution(close + 1, &close)) {
+            char *command = strndup(open + 2, close - open - 2);
+            struct script inner = {0};
+            if (parseCommand(&inner, command, NULL) >= 0) {
+                fuzzWords(&inner);
+            }
+            freeScript(&inner);
+            free(command);
+        }
+    }
+}
+
+#ifndef LIBFUZZER
+/*
+* Standalone driver: run the entry point once on each file given, or on stdin, for reproducing crashes without libFuzzer
+*/
+int main(int argc, char *argv[]) {
+    int arg = 1;
+    do {
+        FILE *file = arg < argc ? fopen(argv[arg], "rb") : stdin;
+        if (file == NULL) {
+            perror(argv[arg]);
+            return 1;
+        }
+        // Read the whole input, growing the buffer as needed
+        size_t size = 0, cap = 4096, numBytes;
+        uint8_t *data = malloc(cap);
+        while ((numBytes = fread(data + size, 1, cap - size, file)) > 0) {
+            size += numBytes;
+            if (size == cap) {
+                cap *= 2;
+                data = realloc(data, cap);
+            }
+        }
+        if (file != stdin) {
+            fclose(file);
+        }
+        LLVMFuzzerTestOneInput(data, size);
+        free(data);
+        arg++;
+    } while (arg < argc);
+    return 0;
+}
+#endif
@@ -0,0 +1,124 @@
+/* Parser interface of smallsh: the parsed form of command lines and scripts, shared by the shell and the parser's
+   fuzzer and benchmark, which link only the parser in parse.c, built as libsmallsh.a */
+#ifndef SMALLSH_H
+#define SMALLSH_H
+
+#include <stddef.h>
+
+/* Define macros */
+#define MAX_PID_LENGTH 7
+#define MAX_LLONG_LENGTH 20
+#define TEE_LIMIT 8
+
+/* AST node types */
+#define NODE_SIMPLE 0
+#define NODE_SEQ 1
+#define NODE_AND 2
+#define NODE_OR 3
+#define NODE_FOR 4
+#define NODE_WHILE 5
+#define NODE_LAST NODE_WHILE
+
+/* Expansions a word needs when its command runs */
+#define WORD_PID 1
+#define WORD_GLOB 2
+#define WORD_VAR 4
+#define WORD_HEREDOC 8
+#define WORD_CMDSUB 16
+#define WORD_ARITH 32
+
+/* Node of a parsed command list; nodes refer to each other and to words by index */
+struct astNode
+{
+    int type;        // NODE_SIMPLE, a loop, or the operator joining left and right
+    int left;        // Left child node, the condition of a while loop, or the body of a for loop; or -1
+    int right;       // Right child node, or the body of a while loop; or -1
+    int wordStart;   // First word of a simple command, or of the words a for loop runs over
+    int wordCount;   // Number of words
+    int var;         // Word holding the variable name of a for loop, or -1
+    int inputFile;   // Word to redirect input from, or -1
+    int outputFile;  // Word to redirect output to, or -1
+    int teeStart;    // First word of the files given with ">+", which all get a copy of the output
+    int teeCount;    // Number of ">+" files
+    int background;  // Flag for a simple command ended by "&"
+    int priority;    // Admission priority given with "&N"
+};
+
+/* Word of a simple command */
+struct astWord
+{
+    int str;         // Offset of the text in the string table
+    int flags;       // WORD_PID, WORD_VAR, WORD_CMDSUB, WORD_ARITH and WORD_GLOB expansions to perform; WORD_HEREDOC marks input text, not a file
+};
+
+/* Parsed commands: a node array, a words array and a string table, plus the root node of each line of a script */
+struct script
+{
+    struct astNode *nodes;
+    int nodeCount, nodeCap;
+    struct astWord *words;
+    int wordCount, wordCap;
+    char *strings;
+    int stringLen, stringCap;
+    int *lines;
+    int lineCount, lineCap;
+    char *map;       // Cache file mapping the arrays point into, or NULL if they were allocated
+    size_t mapSize;  // Size of the mapping
+};
+
+/* Arithmetic errors */
+#define ARITH_OK 0
+#define ARITH_SYNTAX 1
+#define ARITH_DIVZERO 2
+#define ARITH_OVERFLOW 3
+#define ARITH_NOTNUMBER 4
+
+/* Node of a parsed arithmetic expression */
+struct arithNode
+{
+    int type;        // ARITH_NUM, ARITH_VAR, or the kind of operator
+    int op;          // Operator character of a unary operator, or binary operator of a binary node or compound assignment, or -1
+    long long value; // Value of a number
+    char *name;      // Variable name, pointing into the expression
+    int nameLen;     // Length of the name
+    int left, right, third;  // Operand nodes, or -1
+};
+
+/* Arithmetic expression being parsed or evaluated */
+struct arithExpr
+{
+    struct arithNode *nodes;
+    int count;
+    char *pos;       // Next character to parse
+    int error;       // First error found, or ARITH_OK
+    char *errorName; // Variable that is not a number, for ARITH_NOTNUMBER
+    int errorLen;
+    char *(*readVar)(char *name, int len);     // Reads a variable for evaluation, or NULL to read every variable as unset
+    void (*writeVar)(char *name, char *value); // Sets a variable assigned in the expression, or NULL to drop assignments
+};
+
+/* Supplier of the lines that continue a command, such as the body of a loop */
+struct lineSource
+{
+    char *(*next)(struct lineSource *source);  // Returns the next line with a command, or NULL at the end of input
+    char *text;        // Script text not yet split into lines
+    char *saveptr;     // Position in the script text
+    char **lines;      // Lines read from the user, kept until the command is parsed
+    int lineCount, lineCap;
+    _Bool raw;         // Flag to return lines as they are, blank lines and comments included, for a here-document
+};
+
+/* Parser functions */
+int parseCommand(struct script *script, char *userInput, struct lineSource *source);
+int compileScript(char *text, struct script *script);
+void resetScript(struct script *script);
+void freeScript(struct script *script);
+_Bool isName(char *text, int len);
+char *nextSubstitution(char *text, char **close);
+char *matchParen(char *open);
+char *matchArith(char *open);
+int parseArith(struct arithExpr *expr, char *text);
+int evalArith(struct arithExpr *expr, int node, long long *value);
+char *varExp(char *token, int shellPid);
+
+#endif